@@ -0,0 +1,140 @@
+#include "chip8c.h"
+
+#include "Chip8.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+struct chip8_t
+{
+    Chip8 chip;
+    mutable Chip8Snapshot scratch; // Staging, the caller's buffer may not be aligned for a snapshot
+};
+
+static_assert(CHIP8C_SCREEN_WIDTH == CPU::SCREEN_WIDTH && CHIP8C_SCREEN_HEIGHT == CPU::SCREEN_HEIGHT);
+static_assert(CHIP8C_MEMORY_SIZE == sizeof(CPUState::_memory));
+static_assert(CHIP8_DISPATCH_THREADED == (int)DispatchMode::Threaded);
+
+chip8_t* chip8_create(void)
+{
+    chip8_t* handle = new (std::nothrow) chip8_t();
+    if (!handle)
+        return nullptr; // Fails
+
+    // Environments step in bulk, so default to the fastest interpreter we have
+    if (CPU::HasThreadedDispatch())
+        handle->chip.GetCPU()->SetDispatchMode(DispatchMode::Threaded);
+    return handle;
+}
+
+void chip8_destroy(chip8_t* chip)
+{
+    delete chip;
+}
+
+int chip8_load_rom(chip8_t* chip, const uint8_t* data, size_t size)
+{
+    return chip->chip.LoadROM(data, size) ? 1 : 0;
+}
+
+void chip8_reset(chip8_t* chip)
+{
+    chip->chip.Reset();
+}
+
+void chip8_seed(chip8_t* chip, uint32_t seed)
+{
+    chip->chip.SetSeed(seed);
+}
+
+void chip8_set_key(chip8_t* chip, int key, int down)
+{
+    if (key < 0 || key > 0xF)
+        return; // Fails
+
+    if (down)
+        chip->chip.KeyDown((u8)key);
+    else
+        chip->chip.KeyUp((u8)key);
+}
+
+void chip8_set_keys(chip8_t* chip, uint16_t mask)
+{
+    for (u8 k = 0; k < 16; k++)
+        chip8_set_key(chip, k, (mask >> k) & 1);
+}
+
+void chip8_set_cycles_per_frame(chip8_t* chip, int cycles)
+{
+    chip->chip.SetCyclesPerFrame(cycles);
+}
+
+int chip8_set_dispatch_mode(chip8_t* chip, int mode)
+{
+    if (mode < CHIP8_DISPATCH_SWITCH || mode > CHIP8_DISPATCH_THREADED)
+        return 0; // Fails
+
+    chip->chip.GetCPU()->SetDispatchMode((DispatchMode)mode);
+    return 1;
+}
+
+void chip8_step_frames(chip8_t* chip, int frames)
+{
+    if (frames <= 0)
+        return;
+
+    // RunCycles ticks the timers on every frame boundary it crosses, so one call covers all of them
+    chip->chip.RunCycles((u32)frames * (u32)chip->chip.GetCyclesPerFrame());
+}
+
+uint64_t chip8_cycles(const chip8_t* chip)
+{
+    return chip->chip.GetTotalCycles();
+}
+
+const uint64_t* chip8_framebuffer(const chip8_t* chip)
+{
+    return chip->chip.GetCPU()->GetPlane();
+}
+
+const uint8_t* chip8_memory(const chip8_t* chip)
+{
+    return chip->chip.GetCPU()->GetMemory();
+}
+
+size_t chip8_read_memory(const chip8_t* chip, uint16_t addr, uint8_t* out, size_t count)
+{
+    const size_t size = chip->chip.GetCPU()->GetMemorySize();
+    if (addr >= size)
+        return 0; // Fails
+
+    const size_t n = std::min(count, size - addr);
+    std::memcpy(out, chip->chip.GetCPU()->GetMemory() + addr, n);
+    return n;
+}
+
+size_t chip8_state_size(void)
+{
+    return sizeof(Chip8Snapshot);
+}
+
+size_t chip8_save_state(const chip8_t* chip, void* out, size_t size)
+{
+    if (size < sizeof(Chip8Snapshot))
+        return 0; // Fails
+
+    // The caller's buffer needn't be aligned for the snapshot
+    chip->chip.SaveState(chip->scratch);
+    std::memcpy(out, &chip->scratch, sizeof(Chip8Snapshot));
+    return sizeof(Chip8Snapshot);
+}
+
+int chip8_load_state(chip8_t* chip, const void* data, size_t size)
+{
+    if (size < sizeof(Chip8Snapshot))
+        return 0; // Fails
+
+    std::memcpy(&chip->scratch, data, sizeof(Chip8Snapshot));
+    return chip->chip.LoadState(chip->scratch) ? 1 : 0;
+}
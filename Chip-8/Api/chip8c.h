@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+ * Plain C interface to the emulator core, for embedding in other languages and for
+ * driving it as a reinforcement learning environment (reset, set keys, step, observe).
+ *
+ * Every function takes the handle returned by chip8_create. A handle is not thread safe,
+ * but separate handles share nothing and may be stepped from different threads.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #if defined(CHIP8C_BUILD_SHARED)
+        #define CHIP8C_API __declspec(dllexport)
+    #elif defined(CHIP8C_SHARED)
+        #define CHIP8C_API __declspec(dllimport)
+    #else
+        #define CHIP8C_API
+    #endif
+#elif defined(__GNUC__)
+    #define CHIP8C_API __attribute__((visibility("default")))
+#else
+    #define CHIP8C_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct chip8_t chip8_t;
+
+#define CHIP8C_SCREEN_WIDTH 64
+#define CHIP8C_SCREEN_HEIGHT 32
+#define CHIP8C_MEMORY_SIZE 4096
+
+/* Same order as DispatchMode */
+enum
+{
+    CHIP8_DISPATCH_SWITCH = 0,
+    CHIP8_DISPATCH_TABLE = 1,
+    CHIP8_DISPATCH_CACHED = 2,
+    CHIP8_DISPATCH_BLOCK = 3,
+    CHIP8_DISPATCH_JIT = 4,
+    CHIP8_DISPATCH_STATIC = 5,
+    CHIP8_DISPATCH_THREADED = 6
+};
+
+/* Null on allocation failure */
+CHIP8C_API chip8_t* chip8_create(void);
+CHIP8C_API void chip8_destroy(chip8_t* chip);
+
+/* The ROM is copied. Returns 0 if it is empty or does not fit in memory, and the old ROM stays loaded. */
+CHIP8C_API int chip8_load_rom(chip8_t* chip, const uint8_t* data, size_t size);
+/* Back to the state right after chip8_load_rom */
+CHIP8C_API void chip8_reset(chip8_t* chip);
+/* Seeds CXNN now and on every later load and reset, for reproducible episodes */
+CHIP8C_API void chip8_seed(chip8_t* chip, uint32_t seed);
+
+/* key is 0x0 to 0xF */
+CHIP8C_API void chip8_set_key(chip8_t* chip, int key, int down);
+/* Bit k of mask holds key k, for setting the whole keypad once per step */
+CHIP8C_API void chip8_set_keys(chip8_t* chip, uint16_t mask);
+
+CHIP8C_API void chip8_set_cycles_per_frame(chip8_t* chip, int cycles);
+/* Returns 0 for an unknown mode */
+CHIP8C_API int chip8_set_dispatch_mode(chip8_t* chip, int mode);
+
+/* Runs frames 60 Hz frames of cycles_per_frame instructions each */
+CHIP8C_API void chip8_step_frames(chip8_t* chip, int frames);
+CHIP8C_API uint64_t chip8_cycles(const chip8_t* chip);
+
+/* CHIP8C_SCREEN_HEIGHT words, one per row, bit 63 is the leftmost column.
+   Points into the emulator, stays valid for the life of the handle and changes as it steps. */
+CHIP8C_API const uint64_t* chip8_framebuffer(const chip8_t* chip);
+/* CHIP8C_MEMORY_SIZE bytes, same lifetime as the framebuffer. Scores and lives live here. */
+CHIP8C_API const uint8_t* chip8_memory(const chip8_t* chip);
+/* Copies count bytes starting at addr, for reading reward bytes scattered through memory.
+   Returns the bytes copied, fewer than count if the range runs off the end. */
+CHIP8C_API size_t chip8_read_memory(const chip8_t* chip, uint16_t addr, uint8_t* out, size_t count);
+
+/* Save states are flat byte blobs of chip8_state_size() bytes, only readable by the same build.
+   Saving or loading one is a copy, cheap enough to do every frame. */
+CHIP8C_API size_t chip8_state_size(void);
+/* Returns the bytes written, 0 if size is too small */
+CHIP8C_API size_t chip8_save_state(const chip8_t* chip, void* out, size_t size);
+/* Returns 0 if the blob is not a save state of this version */
+CHIP8C_API int chip8_load_state(chip8_t* chip, const void* data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Types.h"
+
+// Receives the tone state once per 60 Hz timer tick of emulated time.
+// Tick is called on the emulation thread and must never block it.
+class AudioSink
+{
+public:
+    virtual ~AudioSink() = default;
+
+    virtual void Tick(bool toneOn) = 0;
+};
+
+// Discards everything, for headless runs that don't want sound
+class NullAudioSink : public AudioSink
+{
+public:
+    void Tick(bool) override {}
+};
@@ -0,0 +1,17 @@
+#include "ToneSynth.h"
+
+ToneSynth::ToneSynth(u32 sampleRate, u32 frequency, i16 amplitude)
+    : _sampleRate(sampleRate), _amplitude(amplitude)
+{
+    // 32 bit phase accumulator, the top bit is the square wave
+    _step = (u32)(((u64)frequency << 32) / sampleRate);
+}
+
+void ToneSynth::Generate(i16* out, u32 count, bool on)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        out[i] = on ? (_phase & 0x80000000 ? _amplitude : (i16)-_amplitude) : 0;
+        _phase += _step;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Types.h"
+
+// Square wave beeper, 16 bit mono
+class ToneSynth
+{
+public:
+    ToneSynth(u32 sampleRate, u32 frequency = 440, i16 amplitude = 3000);
+
+    // Silence while off, the phase keeps running so the next tone starts cleanly
+    void Generate(i16* out, u32 count, bool on);
+
+    const u32 GetSampleRate() const { return _sampleRate; }
+    const u32 GetSamplesPerTick() const { return _sampleRate / 60; }
+
+private:
+    u32 _sampleRate;
+    u32 _step;
+    u32 _phase = 0;
+    i16 _amplitude;
+};
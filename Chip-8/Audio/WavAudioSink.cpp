@@ -0,0 +1,69 @@
+#include "WavAudioSink.h"
+
+#include <fstream>
+#include <utility>
+
+namespace
+{
+    void WriteU32(std::ofstream& file, u32 value)
+    {
+        const char bytes[4] = { (char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24) };
+        file.write(bytes, 4);
+    }
+
+    void WriteU16(std::ofstream& file, u16 value)
+    {
+        const char bytes[2] = { (char)value, (char)(value >> 8) };
+        file.write(bytes, 2);
+    }
+}
+
+WavAudioSink::WavAudioSink(std::string path, u32 sampleRate)
+    : _path(std::move(path)), _synth(sampleRate)
+{
+}
+
+WavAudioSink::~WavAudioSink()
+{
+    Close();
+}
+
+void WavAudioSink::Tick(bool toneOn)
+{
+    const size_t start = _samples.size();
+    _samples.resize(start + _synth.GetSamplesPerTick());
+    _synth.Generate(_samples.data() + start, _synth.GetSamplesPerTick(), toneOn);
+}
+
+bool WavAudioSink::Close()
+{
+    if (_closed)
+        return true;
+    _closed = true;
+
+    std::ofstream file(_path, std::ios::binary);
+    if (!file)
+        return false; // Fails
+
+    const u32 dataSize = (u32)(_samples.size() * sizeof(i16));
+
+    file.write("RIFF", 4);
+    WriteU32(file, 36 + dataSize);
+    file.write("WAVE", 4);
+
+    file.write("fmt ", 4);
+    WriteU32(file, 16);
+    WriteU16(file, 1); // PCM
+    WriteU16(file, 1); // Mono
+    WriteU32(file, _synth.GetSampleRate());
+    WriteU32(file, _synth.GetSampleRate() * sizeof(i16));
+    WriteU16(file, sizeof(i16));
+    WriteU16(file, 16);
+
+    file.write("data", 4);
+    WriteU32(file, dataSize);
+    for (i16 sample : _samples)
+        WriteU16(file, (u16)sample);
+
+    return (bool)file;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "AudioSink.h"
+#include "ToneSynth.h"
+
+#include <string>
+#include <vector>
+
+// Renders the tone in emulated time and writes it out as a 16 bit mono WAV file.
+// Samples are kept in memory and written by Close() or the destructor.
+class WavAudioSink : public AudioSink
+{
+public:
+    WavAudioSink(std::string path, u32 sampleRate = 44100);
+    ~WavAudioSink() override;
+
+    void Tick(bool toneOn) override;
+
+    bool Close();
+
+private:
+    std::string _path;
+    ToneSynth _synth;
+    std::vector<i16> _samples;
+    bool _closed = false;
+};
@@ -0,0 +1,128 @@
+#include "WaveOutAudioSink.h"
+
+#if defined(_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <mmsystem.h>
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#pragma comment(lib, "winmm.lib")
+#endif
+
+WaveOutAudioSink::WaveOutAudioSink(u32 sampleRate)
+    : _synth(sampleRate)
+{
+    _event = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+
+    WAVEFORMATEX format = {};
+    format.wFormatTag = WAVE_FORMAT_PCM;
+    format.nChannels = 1;
+    format.nSamplesPerSec = sampleRate;
+    format.wBitsPerSample = 16;
+    format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
+    format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+
+    HWAVEOUT device = nullptr;
+    if (!_event || waveOutOpen(&device, WAVE_MAPPER, &format, (DWORD_PTR)_event, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
+        return; // No audio device, ticks are just dropped
+
+    _device = device;
+    _buffers.resize(BUFFER_COUNT * BUFFER_SAMPLES);
+
+    _running = true;
+    _thread = std::thread(&WaveOutAudioSink::ThreadMain, this);
+}
+
+WaveOutAudioSink::~WaveOutAudioSink()
+{
+    _running = false;
+    if (_thread.joinable())
+    {
+        SetEvent((HANDLE)_event);
+        _thread.join();
+    }
+
+    if (_device)
+        waveOutClose((HWAVEOUT)_device);
+    if (_event)
+        CloseHandle((HANDLE)_event);
+}
+
+void WaveOutAudioSink::ThreadMain()
+{
+    HWAVEOUT device = (HWAVEOUT)_device;
+
+    WAVEHDR headers[BUFFER_COUNT] = {};
+    for (u32 i = 0; i < BUFFER_COUNT; i++)
+    {
+        headers[i].lpData = (LPSTR)&_buffers[i * BUFFER_SAMPLES];
+        headers[i].dwBufferLength = BUFFER_SAMPLES * sizeof(i16);
+        waveOutPrepareHeader(device, &headers[i], sizeof(WAVEHDR));
+
+        // Marked done so the loop below queues every buffer on its first pass
+        headers[i].dwFlags |= WHDR_DONE;
+    }
+
+    while (_running)
+    {
+        for (WAVEHDR& header : headers)
+        {
+            if (!(header.dwFlags & WHDR_DONE))
+                continue;
+
+            Fill((i16*)header.lpData, BUFFER_SAMPLES);
+            header.dwFlags &= ~WHDR_DONE;
+            waveOutWrite(device, &header, sizeof(WAVEHDR));
+        }
+
+        WaitForSingleObject((HANDLE)_event, 100);
+    }
+
+    waveOutReset(device);
+    for (WAVEHDR& header : headers)
+        waveOutUnprepareHeader(device, &header, sizeof(WAVEHDR));
+}
+
+void WaveOutAudioSink::Fill(i16* out, u32 count)
+{
+    while (count)
+    {
+        if (!_samplesLeft)
+        {
+            NextTick();
+            _samplesLeft = _synth.GetSamplesPerTick();
+        }
+
+        const u32 n = std::min(count, _samplesLeft);
+        _synth.Generate(out, n, _toneOn);
+
+        out += n;
+        count -= n;
+        _samplesLeft -= n;
+    }
+}
+
+void WaveOutAudioSink::NextTick()
+{
+    bool toneOn = false;
+
+    // Running behind the emulation, skip ahead rather than let latency grow
+    while (_ticks.Size() > MAX_QUEUED_TICKS)
+        _ticks.TryPop(toneOn);
+
+    // After running dry, wait for a couple of ticks so small hiccups don't stutter
+    if (_buffering && _ticks.Size() < 2)
+    {
+        _toneOn = false;
+        return;
+    }
+
+    _buffering = !_ticks.TryPop(toneOn);
+    _toneOn = toneOn;
+}
+
+#endif
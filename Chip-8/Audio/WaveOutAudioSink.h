@@ -0,0 +1,53 @@
+#pragma once
+
+#include "AudioSink.h"
+#include "ToneSynth.h"
+#include "SpscQueue.h"
+
+#if defined(_WIN32)
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Plays the tone through waveOut. Tick only queues the tone state; a separate
+// thread synthesizes samples from that queue as the device asks for them.
+class WaveOutAudioSink : public AudioSink
+{
+public:
+    WaveOutAudioSink(u32 sampleRate = 44100);
+    ~WaveOutAudioSink() override;
+
+    // A full queue means the emulation is running ahead of real time, those ticks are dropped
+    void Tick(bool toneOn) override { _ticks.TryPush(toneOn); }
+
+    bool IsOpen() const { return _device != nullptr; }
+
+private:
+    void ThreadMain();
+    void Fill(i16* out, u32 count);
+    void NextTick();
+
+private:
+    static constexpr u32 BUFFER_COUNT = 4;
+    static constexpr u32 BUFFER_SAMPLES = 512;
+    // Latency cap, older ticks are skipped when the queue grows past this
+    static constexpr size_t MAX_QUEUED_TICKS = 6;
+
+    SpscQueue<bool, 256> _ticks;
+
+    // Audio thread only
+    ToneSynth _synth;
+    u32 _samplesLeft = 0;
+    bool _toneOn = false;
+    bool _buffering = true;
+
+    void* _device = nullptr; // HWAVEOUT
+    void* _event = nullptr; // HANDLE signalled when a buffer finishes
+    std::vector<i16> _buffers;
+
+    std::atomic<bool> _running{ false };
+    std::thread _thread;
+};
+
+#endif
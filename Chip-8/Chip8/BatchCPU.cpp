@@ -0,0 +1,520 @@
+#include "BatchCPU.h"
+
+#include "CPU.h"
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_BATCH_SSE2 1
+#include <emmintrin.h>
+#else
+#define CHIP8_BATCH_SSE2 0
+#endif
+
+namespace
+{
+    constexpr u32 VECTOR_LANES = 16;
+
+    // 16 lanes of u8, SSE2 where there is one and plain loops otherwise
+#if CHIP8_BATCH_SSE2
+    using Vec = __m128i;
+
+    Vec Load(const u8* p) { return _mm_loadu_si128((const __m128i*)p); }
+    void Store(u8* p, Vec v) { _mm_storeu_si128((__m128i*)p, v); }
+    Vec Splat(u8 value) { return _mm_set1_epi8((char)value); }
+
+    Vec Add(Vec a, Vec b) { return _mm_add_epi8(a, b); }
+    Vec Sub(Vec a, Vec b) { return _mm_sub_epi8(a, b); }
+    Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+    Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+    Vec Xor(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+    Vec Eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+    Vec Ne(Vec a, Vec b) { return _mm_xor_si128(_mm_cmpeq_epi8(a, b), _mm_set1_epi8(-1)); }
+    Vec Min(Vec a, Vec b) { return _mm_min_epu8(a, b); }
+    Vec ShiftRight1(Vec a) { return _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7F)); }
+    Vec ShiftRight7(Vec a) { return _mm_and_si128(_mm_srli_epi16(a, 7), _mm_set1_epi8(0x01)); }
+#else
+    struct Vec { u8 b[VECTOR_LANES]; };
+
+    template <typename F>
+    Vec Map(Vec a, Vec b, F f) { Vec r; for (u32 i = 0; i < VECTOR_LANES; i++) r.b[i] = (u8)f(a.b[i], b.b[i]); return r; }
+
+    Vec Load(const u8* p) { Vec v; std::copy(p, p + VECTOR_LANES, v.b); return v; }
+    void Store(u8* p, Vec v) { std::copy(v.b, v.b + VECTOR_LANES, p); }
+    Vec Splat(u8 value) { Vec v; std::fill(v.b, v.b + VECTOR_LANES, value); return v; }
+
+    Vec Add(Vec a, Vec b) { return Map(a, b, [](u8 x, u8 y) { return x + y; }); }
+    Vec Sub(Vec a, Vec b) { return Map(a, b, [](u8 x, u8 y) { return x - y; }); }
+    Vec And(Vec a, Vec b) { return Map(a, b, [](u8 x, u8 y) { return x & y; }); }
+    Vec Or(Vec a, Vec b) { return Map(a, b, [](u8 x, u8 y) { return x | y; }); }
+    Vec Xor(Vec a, Vec b) { return Map(a, b, [](u8 x, u8 y) { return x ^ y; }); }
+    Vec Eq(Vec a, Vec b) { return Map(a, b, [](u8 x, u8 y) { return x == y ? 0xFF : 0; }); }
+    Vec Ne(Vec a, Vec b) { return Map(a, b, [](u8 x, u8 y) { return x != y ? 0xFF : 0; }); }
+    Vec Min(Vec a, Vec b) { return Map(a, b, [](u8 x, u8 y) { return std::min(x, y); }); }
+    Vec ShiftRight1(Vec a) { return Map(a, a, [](u8 x, u8) { return x >> 1; }); }
+    Vec ShiftRight7(Vec a) { return Map(a, a, [](u8 x, u8) { return x >> 7; }); }
+#endif
+
+    // All ones where a > b, unsigned
+    Vec Greater(Vec a, Vec b) { return Ne(Min(a, b), a); }
+}
+
+BatchCPU::BatchCPU(u32 lanes)
+    : _lanes(std::max(1u, lanes))
+{
+    _stride = (_lanes + VECTOR_LANES - 1) / VECTOR_LANES * VECTOR_LANES;
+
+    _memory.resize(4096 * _stride);
+    _registers.resize(16 * _stride);
+    _keys.resize(16 * _stride);
+    _pc.resize(_stride);
+    _opcode.resize(_stride);
+    _index.resize(_stride);
+    _sp.resize(_stride);
+    _delayTimer.resize(_stride);
+    _soundTimer.resize(_stride);
+    _keyWait.resize(_stride);
+    _keyWaitKey.resize(_stride);
+    _stack.resize(16 * _stride);
+    _screen.resize(32 * _stride);
+    _skip.resize(_stride);
+
+    _random.resize(_stride);
+}
+
+void BatchCPU::Reset(const u8* rom, size_t romSize)
+{
+    // Boot through a real CPU so the starting state can't drift from it
+    auto cpu = std::make_unique<CPU>();
+    cpu->Reset(std::vector<char>(rom, rom + romSize), romSize);
+    _boot = cpu->GetState();
+
+    // Padding lanes too, vector ops write them but nothing ever reads them back
+    for (u32 lane = 0; lane < _stride; lane++)
+        SetState(lane, _boot);
+
+    _steps = 0;
+    _uniformSteps = 0;
+    _unknownOpcodes = 0;
+}
+
+void BatchCPU::GetState(u32 lane, CPUState& state) const
+{
+    for (u32 addr = 0; addr < 4096; addr++)
+        state._memory[addr] = _memory[addr * _stride + lane];
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        state._registers[i] = _registers[i * _stride + lane];
+        state._key[i] = _keys[i * _stride + lane];
+        state._stack[i] = _stack[lane * 16 + i];
+    }
+
+    for (u32 row = 0; row < 32; row++)
+        state._screen[row] = _screen[lane * 32 + row];
+
+    state._opcode = _opcode[lane];
+    state._index = _index[lane];
+    state._pc = _pc[lane];
+    state._sp = _sp[lane];
+    state._delayTimer = _delayTimer[lane];
+    state._soundTimer = _soundTimer[lane];
+    state._keyWait = _keyWait[lane];
+    state._keyWaitKey = _keyWaitKey[lane];
+}
+
+void BatchCPU::SetState(u32 lane, const CPUState& state)
+{
+    for (u32 addr = 0; addr < 4096; addr++)
+        _memory[addr * _stride + lane] = state._memory[addr];
+
+    for (u32 i = 0; i < 16; i++)
+    {
+        _registers[i * _stride + lane] = state._registers[i];
+        _keys[i * _stride + lane] = state._key[i];
+        _stack[lane * 16 + i] = state._stack[i];
+    }
+
+    for (u32 row = 0; row < 32; row++)
+        _screen[lane * 32 + row] = state._screen[row];
+
+    _opcode[lane] = state._opcode;
+    _index[lane] = state._index;
+    _pc[lane] = state._pc;
+    _sp[lane] = (u8)state._sp;
+    _delayTimer[lane] = state._delayTimer;
+    _soundTimer[lane] = state._soundTimer;
+    _keyWait[lane] = state._keyWait;
+    _keyWaitKey[lane] = state._keyWaitKey;
+}
+
+void BatchCPU::KeyDown(u32 lane, u8 hex)
+{
+    if (hex >= 16)
+        return;
+
+    _keys[hex * _stride + lane] = 1;
+    if (_keyWait[lane] == KeyWait::Press)
+    {
+        _keyWait[lane] = KeyWait::Release;
+        _keyWaitKey[lane] = hex;
+    }
+}
+
+void BatchCPU::KeyUp(u32 lane, u8 hex)
+{
+    if (hex >= 16)
+        return;
+
+    _keys[hex * _stride + lane] = 0;
+    if (_keyWait[lane] == KeyWait::Release && _keyWaitKey[lane] == hex)
+        _keyWait[lane] = KeyWait::Done;
+}
+
+void BatchCPU::Step()
+{
+    u16 opcode;
+    if (IsUniform(opcode))
+    {
+        std::fill(_opcode.begin(), _opcode.end(), opcode);
+
+        if (ExecuteUniform(opcode))
+            _uniformSteps++;
+        else
+        {
+            // Same instruction everywhere but one that needs per-lane state
+            for (u32 lane = 0; lane < _lanes; lane++)
+            {
+                _pc[lane] += 2;
+                ExecuteLane(lane, opcode);
+            }
+        }
+    }
+    else
+    {
+        for (u32 lane = 0; lane < _lanes; lane++)
+        {
+            const u16 pc = _pc[lane];
+            _opcode[lane] = Memory(lane, pc) << 8 | Memory(lane, pc + 1);
+            _pc[lane] += 2;
+            ExecuteLane(lane, _opcode[lane]);
+        }
+    }
+
+    _steps++;
+}
+
+void BatchCPU::UpdateTimers()
+{
+    // Saturating subtract is exactly "decrement if non-zero"
+    for (u32 i = 0; i < _stride; i += VECTOR_LANES)
+    {
+        Store(&_delayTimer[i], Sub(Load(&_delayTimer[i]), And(Ne(Load(&_delayTimer[i]), Splat(0)), Splat(1))));
+        Store(&_soundTimer[i], Sub(Load(&_soundTimer[i]), And(Ne(Load(&_soundTimer[i]), Splat(0)), Splat(1))));
+    }
+}
+
+void BatchCPU::RunFrame(u32 cyclesPerFrame)
+{
+    for (u32 i = 0; i < cyclesPerFrame; i++)
+        Step();
+
+    UpdateTimers();
+}
+
+bool BatchCPU::IsUniform(u16& opcode) const
+{
+    // Accumulated differences rather than early outs, so the compiler can vectorize the loops
+    const u16 pc = _pc[0];
+    u16 pcDiff = 0;
+    for (u32 lane = 0; lane < _lanes; lane++)
+        pcDiff |= _pc[lane] ^ pc;
+    if (pcDiff)
+        return false;
+
+    // Self-modifying code can leave lanes with different bytes at the same address
+    const u8* high = &_memory[(pc & 0xFFF) * _stride];
+    const u8* low = &_memory[((pc + 1) & 0xFFF) * _stride];
+    u8 opDiff = 0;
+    for (u32 lane = 0; lane < _lanes; lane++)
+        opDiff |= (high[lane] ^ high[0]) | (low[lane] ^ low[0]);
+    if (opDiff)
+        return false;
+
+    opcode = high[0] << 8 | low[0];
+    return true;
+}
+
+bool BatchCPU::ExecuteUniform(u16 opcode)
+{
+    const u16 next = _pc[0] + 2;
+    const u8 x = (opcode >> 8) & 0xF;
+    const u8 y = (opcode >> 4) & 0xF;
+    const u8 nn = opcode & 0xFF;
+    const u16 nnn = opcode & 0xFFF;
+
+    u8* vx = &_registers[x * _stride];
+    u8* vy = &_registers[y * _stride];
+    u8* vf = &_registers[0xF * _stride];
+
+    // Skips: every lane moves on by 2, plus 2 more where the condition held
+    auto skip = [&](auto condition)
+        {
+            for (u32 i = 0; i < _stride; i += VECTOR_LANES)
+                Store(&_skip[i], condition(i));
+            for (u32 lane = 0; lane < _stride; lane++)
+                _pc[lane] = next + (_skip[lane] & 2);
+        };
+
+    switch (opcode >> 12)
+    {
+    case 0x1:
+        std::fill(_pc.begin(), _pc.end(), nnn);
+        return true;
+
+    case 0x3:
+        skip([&](u32 i) { return Eq(Load(&vx[i]), Splat(nn)); });
+        return true;
+
+    case 0x4:
+        skip([&](u32 i) { return Ne(Load(&vx[i]), Splat(nn)); });
+        return true;
+
+    case 0x5:
+        skip([&](u32 i) { return Eq(Load(&vx[i]), Load(&vy[i])); });
+        return true;
+
+    case 0x9:
+        skip([&](u32 i) { return Ne(Load(&vx[i]), Load(&vy[i])); });
+        return true;
+
+    case 0x6:
+        std::fill(vx, vx + _stride, nn);
+        break;
+
+    case 0x7:
+        for (u32 i = 0; i < _stride; i += VECTOR_LANES)
+            Store(&vx[i], Add(Load(&vx[i]), Splat(nn)));
+        break;
+
+    case 0x8:
+    {
+        // The flag forms read operands after writing VF, leave VF aliasing to the per-lane path
+        const u8 n = opcode & 0xF;
+        if (n >= 0x4 && (x == 0xF || y == 0xF))
+            return false;
+
+        for (u32 i = 0; i < _stride; i += VECTOR_LANES)
+        {
+            const Vec a = Load(&vx[i]);
+            const Vec b = Load(&vy[i]);
+
+            switch (n)
+            {
+            case 0x0: Store(&vx[i], b); break;
+            case 0x1: Store(&vx[i], Or(a, b)); break;
+            case 0x2: Store(&vx[i], And(a, b)); break;
+            case 0x3: Store(&vx[i], Xor(a, b)); break;
+            case 0x4:
+            {
+                const Vec sum = Add(a, b);
+                Store(&vf[i], And(Greater(a, sum), Splat(1))); // Wrapped around
+                Store(&vx[i], sum);
+                break;
+            }
+            case 0x5:
+                Store(&vf[i], And(Greater(a, b), Splat(1)));
+                Store(&vx[i], Sub(a, b));
+                break;
+            case 0x6:
+                Store(&vf[i], And(a, Splat(1)));
+                Store(&vx[i], ShiftRight1(a));
+                break;
+            case 0x7:
+                Store(&vf[i], And(Greater(b, a), Splat(1)));
+                Store(&vx[i], Sub(b, a));
+                break;
+            case 0xE:
+                Store(&vf[i], ShiftRight7(a));
+                Store(&vx[i], Add(a, a));
+                break;
+            default:
+                return false;
+            }
+        }
+        break;
+    }
+
+    case 0xA:
+        std::fill(_index.begin(), _index.end(), nnn);
+        break;
+
+    default:
+        return false;
+    }
+
+    std::fill(_pc.begin(), _pc.end(), next);
+    return true;
+}
+
+// Mirrors the CPU handlers. Addresses, stack levels and key numbers are masked
+// where CPU would index out of bounds, which it never does on a well-behaved ROM.
+void BatchCPU::ExecuteLane(u32 lane, u16 opcode)
+{
+    const u8 x = (opcode >> 8) & 0xF;
+    const u8 y = (opcode >> 4) & 0xF;
+    const u8 n = opcode & 0xF;
+    const u8 nn = opcode & 0xFF;
+    const u16 nnn = opcode & 0xFFF;
+
+    u16& pc = _pc[lane];
+    u16& index = _index[lane];
+    u8& sp = _sp[lane];
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (nn == 0xE0)
+            std::fill(&_screen[lane * 32], &_screen[lane * 32 + 32], 0);
+        else if (nn == 0xEE)
+        {
+            sp--;
+            pc = _stack[lane * 16 + (sp & 0xF)];
+        }
+        break;
+
+    case 0x1: pc = nnn; break;
+    case 0x2:
+        _stack[lane * 16 + (sp & 0xF)] = pc;
+        sp++;
+        pc = nnn;
+        break;
+
+    case 0x3: if (V(lane, x) == nn) pc += 2; break;
+    case 0x4: if (V(lane, x) != nn) pc += 2; break;
+    case 0x5: if (V(lane, x) == V(lane, y)) pc += 2; break;
+    case 0x6: V(lane, x) = nn; break;
+    case 0x7: V(lane, x) += nn; break;
+
+    case 0x8:
+        switch (n)
+        {
+        case 0x0: V(lane, x) = V(lane, y); break;
+        case 0x1: V(lane, x) |= V(lane, y); break;
+        case 0x2: V(lane, x) &= V(lane, y); break;
+        case 0x3: V(lane, x) ^= V(lane, y); break;
+        case 0x4:
+        {
+            const u16 sum = V(lane, x) + V(lane, y);
+            V(lane, 0xF) = sum > 255 ? 1 : 0;
+            V(lane, x) = sum & 0xFF;
+            break;
+        }
+        case 0x5:
+            V(lane, 0xF) = V(lane, x) > V(lane, y) ? 1 : 0;
+            V(lane, x) -= V(lane, y);
+            break;
+        case 0x6:
+            V(lane, 0xF) = V(lane, x) & 0x1;
+            V(lane, x) >>= 1;
+            break;
+        case 0x7:
+            V(lane, 0xF) = V(lane, y) > V(lane, x) ? 1 : 0;
+            V(lane, x) = V(lane, y) - V(lane, x);
+            break;
+        case 0xE:
+            V(lane, 0xF) = (V(lane, x) & 0x80) >> 7;
+            V(lane, x) <<= 1;
+            break;
+        default:
+            _unknownOpcodes++;
+            break;
+        }
+        break;
+
+    case 0x9: if (V(lane, x) != V(lane, y)) pc += 2; break;
+    case 0xA: index = nnn; break;
+    case 0xB: pc = V(lane, 0) + nnn; break;
+    case 0xC: V(lane, x) = _random[lane].NextByte() & nn; break;
+
+    case 0xD:
+    {
+        const u8 xPos = V(lane, x) & 63;
+        const u8 yPos = V(lane, y) & 31;
+
+        V(lane, 0xF) = 0;
+        for (u32 row = 0; row < n; row++)
+        {
+            const u64 sprite = std::rotr((u64)Memory(lane, index + row) << 56, xPos);
+            u64& line = _screen[lane * 32 + ((yPos + row) & 31)];
+
+            if (line & sprite)
+                V(lane, 0xF) = 1;
+
+            line ^= sprite;
+        }
+        break;
+    }
+
+    case 0xE:
+    {
+        const u8 key = _keys[(V(lane, x) & 0xF) * _stride + lane];
+        if (nn == 0x9E)
+        {
+            if (key)
+                pc += 2;
+        }
+        else if (nn == 0xA1)
+        {
+            if (!key)
+                pc += 2;
+        }
+        else
+            _unknownOpcodes++;
+        break;
+    }
+
+    case 0xF:
+        switch (nn)
+        {
+        case 0x07: V(lane, x) = _delayTimer[lane]; break;
+        case 0x0A:
+            if (_keyWait[lane] == KeyWait::Done)
+            {
+                V(lane, x) = _keyWaitKey[lane];
+                _keyWait[lane] = KeyWait::None;
+                break;
+            }
+            if (_keyWait[lane] == KeyWait::None)
+                _keyWait[lane] = KeyWait::Press;
+            pc -= 2;
+            break;
+        case 0x15: _delayTimer[lane] = V(lane, x); break;
+        case 0x18: _soundTimer[lane] = V(lane, x); break;
+        case 0x1E: index += V(lane, x); break;
+        case 0x29: index = FONTSET_START_ADDRESS + 5 * V(lane, x); break;
+        case 0x33:
+        {
+            const u8 value = V(lane, x);
+            Memory(lane, index) = value / 100;
+            Memory(lane, index + 1) = value / 10 % 10;
+            Memory(lane, index + 2) = value % 10;
+            break;
+        }
+        case 0x55:
+            for (u8 i = 0; i <= x; i++)
+                Memory(lane, index + i) = V(lane, i);
+            break;
+        case 0x65:
+            for (u8 i = 0; i <= x; i++)
+                V(lane, i) = Memory(lane, index + i);
+            break;
+        default:
+            _unknownOpcodes++;
+            break;
+        }
+        break;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Types.h"
+#include "CPUState.h"
+#include "Random.h"
+
+#include <vector>
+
+// N instances of the same ROM stepped in lockstep, for workloads that run many copies
+// with different inputs. State is kept as structure of arrays, lane fastest, so when
+// every lane is at the same instruction the common ALU ops, skips and jumps run with
+// SIMD across all lanes at once. Lanes that have diverged are stepped one by one.
+//
+// Each lane behaves exactly like a CPU driven by Chip8: Step() is one instruction,
+// RunFrame() is Chip8::Cycle() including the 60 Hz timer tick.
+class BatchCPU
+{
+public:
+    BatchCPU(u32 lanes);
+
+    // Loads the same ROM into every lane
+    void Reset(const u8* rom, size_t romSize);
+    // Puts one lane back to the state Reset() left it in
+    void ResetLane(u32 lane) { SetState(lane, _boot); }
+
+    void SeedRandom(u32 lane, u32 seed) { _random[lane].Seed(seed); }
+
+    // Also move a lane halted on FX0A along, as CPU's do
+    void KeyDown(u32 lane, u8 hex);
+    void KeyUp(u32 lane, u8 hex);
+
+    // One instruction in every lane
+    void Step();
+    void UpdateTimers();
+    void RunFrame(u32 cyclesPerFrame);
+
+    const u32 GetLaneCount() const { return _lanes; }
+
+    void GetState(u32 lane, CPUState& state) const;
+    void SetState(u32 lane, const CPUState& state);
+
+    const u64* GetPlane(u32 lane) const { return &_screen[lane * 32]; }
+    const u8 PeekMemory(u32 lane, u16 addr) const { return Memory(lane, addr); }
+
+    // How many Step() calls ran vectorized, against the total
+    const u64 GetUniformSteps() const { return _uniformSteps; }
+    const u64 GetSteps() const { return _steps; }
+    const u64 GetUnknownOpcodes() const { return _unknownOpcodes; }
+
+private:
+    u8& Memory(u32 lane, u16 addr) { return _memory[(addr & 0xFFF) * _stride + lane]; }
+    const u8& Memory(u32 lane, u16 addr) const { return _memory[(addr & 0xFFF) * _stride + lane]; }
+    u8& V(u32 lane, u8 reg) { return _registers[reg * _stride + lane]; }
+
+    bool IsUniform(u16& opcode) const;
+    bool ExecuteUniform(u16 opcode);
+    void ExecuteLane(u32 lane, u16 opcode);
+
+private:
+    static constexpr u16 FONTSET_START_ADDRESS = 0x50;
+
+    CPUState _boot;
+
+    u32 _lanes;
+    u32 _stride; // Lanes rounded up to a whole vector
+
+    // Indexed [field * _stride + lane] unless noted
+    std::vector<u8> _memory; // [addr * _stride + lane]
+    std::vector<u8> _registers;
+    std::vector<u8> _keys;
+    std::vector<u16> _pc;
+    std::vector<u16> _opcode;
+    std::vector<u16> _index;
+    std::vector<u8> _sp;
+    std::vector<u8> _delayTimer;
+    std::vector<u8> _soundTimer;
+    std::vector<KeyWait> _keyWait;
+    std::vector<u8> _keyWaitKey;
+    std::vector<u16> _stack; // [lane * 16 + level]
+    std::vector<u64> _screen; // [lane * 32 + row]
+
+    std::vector<u8> _skip; // Per lane scratch for vectorized skips
+
+    // Same generator per lane as CPU, so seeded lanes match it exactly
+    std::vector<Random> _random;
+
+    u64 _steps = 0;
+    u64 _uniformSteps = 0;
+    u64 _unknownOpcodes = 0;
+};
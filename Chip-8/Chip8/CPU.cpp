@@ -1,103 +1,535 @@
 #include "CPU.h"
 
+#include "PixelExpander.h"
+
+#include <algorithm>
+#include <bit>
 #include <cstdio>
+#include <cstring>
+
+const std::array<CPU::OpHandler, 16 * 256> CPU::_dispatchTable = CPU::BuildDispatchTable();
+
+bool DispatchModeFromName(const char* name, DispatchMode& mode)
+{
+    const struct { const char* name; DispatchMode mode; } modes[] =
+    {
+        { "switch", DispatchMode::Switch },
+        { "table", DispatchMode::Table },
+        { "cached", DispatchMode::Cached },
+        { "block", DispatchMode::Block },
+        { "jit", DispatchMode::Jit },
+        { "static", DispatchMode::Static },
+        { "threaded", DispatchMode::Threaded }
+    };
+
+    for (const auto& entry : modes)
+    {
+        if (std::strcmp(entry.name, name) == 0)
+        {
+            mode = entry.mode;
+            return true;
+        }
+    }
+    return false; // Fails
+}
 
 void CPU::Fetch()
 {
-    _opcode = (_memory[_pc] << 8) | _memory[_pc + 1];
+    // BNNN can jump past 0xFFF; wrap so the cache lookup stays in range.
+    // Every mode reads through PeekOpcode, so they all see 0 past the last byte.
+    _pc &= 0xFFF;
+
+    if (_dispatchMode >= DispatchMode::Cached)
+    {
+        if (!_icache[_pc].handler)
+            Predecode(_pc);
+
+        _inst = &_icache[_pc];
+        _opcode = _inst->opcode;
+    }
+    else
+        _opcode = PeekOpcode(_pc);
+
     _pc += 2;
 }
 
 void CPU::Decode()
 {
-    _addr = _opcode & 0x0FFF;
-    _byte = _opcode & 0x00FF;
-    _hNibble = _opcode & 0xF000;
-    _lNibble = _opcode & 0x000F;
-    _x = (_opcode & 0x0F00) >> 8;
-    _y = (_opcode & 0x00F0) >> 4;
+    switch (_dispatchMode)
+    {
+    case DispatchMode::Switch:
+        _decoded = MakeInstruction(_opcode, DecodeSwitch(_opcode));
+        _inst = &_decoded;
+        break;
+    case DispatchMode::Table:
+        _decoded = MakeInstruction(_opcode, _dispatchTable[DispatchIndex(_opcode)]);
+        _inst = &_decoded;
+        break;
+    case DispatchMode::Cached:
+    case DispatchMode::Block:
+    case DispatchMode::Jit:
+    case DispatchMode::Static:
+    case DispatchMode::Threaded:
+        break; // Already decoded by Fetch
+    }
 }
 
 void CPU::Execute()
 {
-    switch (_hNibble)
+    (this->*_inst->handler)();
+}
+
+CPU::OpHandler CPU::DecodeSwitch(u16 opcode)
+{
+    switch (opcode & 0xF000)
     {
     case 0x0000:
     {
-        switch (_byte)
+        switch (opcode & 0x00FF)
         {
-        case 0x0E0: OP_00E0(); break;
-        case 0x0EE: OP_00EE(); break;
-        default: OP_0NNN(); break;
+        case 0x0E0: return &CPU::OP_00E0;
+        case 0x0EE: return &CPU::OP_00EE;
+        default: return &CPU::OP_0NNN;
         }
-    } break;
-    case 0x1000: OP_1NNN(); break;
-    case 0x2000: OP_2NNN(); break;
-    case 0x3000: OP_3XNN(); break;
-    case 0x4000: OP_4XNN(); break;
-    case 0x5000: OP_5XY0(); break;
-    case 0x6000: OP_6XNN(); break;
-    case 0x7000: OP_7XNN(); break;
+    }
+    case 0x1000: return &CPU::OP_1NNN;
+    case 0x2000: return &CPU::OP_2NNN;
+    case 0x3000: return &CPU::OP_3XNN;
+    case 0x4000: return &CPU::OP_4XNN;
+    case 0x5000: return &CPU::OP_5XY0;
+    case 0x6000: return &CPU::OP_6XNN;
+    case 0x7000: return &CPU::OP_7XNN;
     case 0x8000:
     {
-        switch (_lNibble)
+        switch (opcode & 0x000F)
         {
-        case 0x0: OP_8XY0(); break;
-        case 0x1: OP_8XY1(); break;
-        case 0x2: OP_8XY2(); break;
-        case 0x3: OP_8XY3(); break;
-        case 0x4: OP_8XY4(); break;
-        case 0x5: OP_8XY5(); break;
-        case 0x6: OP_8XY6(); break;
-        case 0x7: OP_8XY7(); break;
-        case 0xE: OP_8XYE(); break;
-        default: printf("Unknown 8XY?: 0x%04X\n", _opcode); break;
+        case 0x0: return &CPU::OP_8XY0;
+        case 0x1: return &CPU::OP_8XY1;
+        case 0x2: return &CPU::OP_8XY2;
+        case 0x3: return &CPU::OP_8XY3;
+        case 0x4: return &CPU::OP_8XY4;
+        case 0x5: return &CPU::OP_8XY5;
+        case 0x6: return &CPU::OP_8XY6;
+        case 0x7: return &CPU::OP_8XY7;
+        case 0xE: return &CPU::OP_8XYE;
+        default: return &CPU::OP_NULL;
         }
-    } break;
-    case 0x9000: OP_9XY0(); break;
-    case 0xA000: OP_ANNN(); break;
-    case 0xB000: OP_BNNN(); break;
-    case 0xC000: OP_CXNN(); break;
-    case 0xD000: OP_DXYN(); break;
+    }
+    case 0x9000: return &CPU::OP_9XY0;
+    case 0xA000: return &CPU::OP_ANNN;
+    case 0xB000: return &CPU::OP_BNNN;
+    case 0xC000: return &CPU::OP_CXNN;
+    case 0xD000: return &CPU::OP_DXYN;
     case 0xE000:
     {
-        switch (_byte)
+        switch (opcode & 0x00FF)
         {
-        case 0x009E: OP_EX9E(); break;
-        case 0x00A1: OP_EXA1(); break;
-        default: printf("Unknown EX??: 0x%04X\n", _opcode); break;
+        case 0x009E: return &CPU::OP_EX9E;
+        case 0x00A1: return &CPU::OP_EXA1;
+        default: return &CPU::OP_NULL;
         }
-    } break;
+    }
     case 0xF000:
     {
-        switch (_byte)
+        switch (opcode & 0x00FF)
+        {
+        case 0x0007: return &CPU::OP_FX07;
+        case 0x000A: return &CPU::OP_FX0A;
+        case 0x0015: return &CPU::OP_FX15;
+        case 0x0018: return &CPU::OP_FX18;
+        case 0x001E: return &CPU::OP_FX1E;
+        case 0x0029: return &CPU::OP_FX29;
+        case 0x0033: return &CPU::OP_FX33;
+        case 0x0055: return &CPU::OP_FX55;
+        case 0x0065: return &CPU::OP_FX65;
+        default: return &CPU::OP_NULL;
+        }
+    }
+    }
+
+    return &CPU::OP_NULL;
+}
+
+std::array<CPU::OpHandler, 16 * 256> CPU::BuildDispatchTable()
+{
+    // The handler only ever depends on the high nibble and the low byte,
+    // so one entry per combination covers the whole opcode space.
+    std::array<OpHandler, 16 * 256> table{};
+
+    for (u16 i = 0; i < table.size(); i++)
+    {
+        u16 opcode = ((i & 0xF00) << 4) | (i & 0x0FF);
+        table[DispatchIndex(opcode)] = DecodeSwitch(opcode);
+    }
+
+    return table;
+}
+
+CPU::Instruction CPU::MakeInstruction(u16 opcode, OpHandler handler)
+{
+    Instruction inst;
+    inst.handler = handler;
+    inst.opcode = opcode;
+    inst.nnn = opcode & 0x0FFF;
+    inst.nn = opcode & 0x00FF;
+    inst.n = opcode & 0x000F;
+    inst.x = (opcode & 0x0F00) >> 8;
+    inst.y = (opcode & 0x00F0) >> 4;
+    return inst;
+}
+
+void CPU::Predecode(u16 addr)
+{
+    const u16 opcode = PeekOpcode(addr);
+    _icache[addr] = MakeInstruction(opcode, _dispatchTable[DispatchIndex(opcode)]);
+}
+
+void CPU::InvalidateCode(u16 addr, u16 length)
+{
+    // The entry one byte before the write also decoded the first written byte
+    const u32 first = addr ? addr - 1 : 0;
+    const u32 last = std::min<u32>(addr + length, (u32)_icache.size());
+
+    _jit.Invalidate(addr, length);
+
+    bool hitBlock = false;
+    for (u32 a = first; a < last; a++)
+    {
+        _icache[a].handler = nullptr;
+
+        // Ahead of time code can't be patched, so self-modifying ROMs go back to the interpreter
+        if (_staticCode[a])
+            BindStaticProgram(nullptr);
+
+        hitBlock |= _blockCode[a];
+    }
+
+    if (hitBlock)
+        FlushBlocks();
+}
+
+u32 CPU::SkipIdleLoop(u32 budget)
+{
+    // Busy code rarely starts a chunk in an idle loop, so after a miss leave that PC be for a while.
+    // Missing a loop only costs time, the laps just get run.
+    u8& backoff = _idleBackoff[_pc & 0xFFF];
+    if (backoff)
+    {
+        backoff--;
+        return 0;
+    }
+
+    std::array<u8, 16> v = _registers;
+    u32 length = 0;
+    u16 lastOpcode = 0;
+    // The first lap can load DT into registers, every lap after that must leave them
+    // alone and take as many instructions as the first
+    bool idle = IdleLap(v, length, lastOpcode);
+    if (idle)
+    {
+        std::array<u8, 16> settled = v;
+        u32 settledLength = 0;
+        u16 settledLastOpcode = 0;
+        idle = IdleLap(settled, settledLength, settledLastOpcode) &&
+            settled == v && settledLength == length && settledLastOpcode == lastOpcode;
+    }
+
+    if (!idle)
+    {
+        backoff = IDLE_BACKOFF;
+        return 0;
+    }
+
+    if (budget < length)
+        return 0;
+
+    _registers = v;
+    _opcode = lastOpcode;
+    return budget / length * length;
+}
+
+bool CPU::IdleLap(std::array<u8, 16>& v, u32& length, u16& lastOpcode) const
+{
+    u16 pc = _pc;
+    length = 0;
+
+    do
+    {
+        if (length == MAX_IDLE_LOOP)
+            return false; // Fails
+
+        const u16 opcode = PeekOpcode(pc);
+        const u8 x = (opcode >> 8) & 0xF;
+        const u8 y = (opcode >> 4) & 0xF;
+        const u8 nn = opcode & 0xFF;
+
+        bool skip = false;
+        switch (opcode & 0xF000)
         {
-        case 0x0007: OP_FX07(); break;
-        case 0x000A: OP_FX0A(); break;
-        case 0x0015: OP_FX15(); break;
-        case 0x0018: OP_FX18(); break;
-        case 0x001E: OP_FX1E(); break;
-        case 0x0029: OP_FX29(); break;
-        case 0x0033: OP_FX33(); break;
-        case 0x0055: OP_FX55(); break;
-        case 0x0065: OP_FX65(); break;
-        default: printf("Unknown FX??: 0x%04X\n", _opcode); break;
+        case 0x1000: break;
+        case 0x3000: skip = v[x] == nn; break;
+        case 0x4000: skip = v[x] != nn; break;
+        case 0x5000: if (opcode & 0xF) return false; skip = v[x] == v[y]; break;
+        case 0x9000: if (opcode & 0xF) return false; skip = v[x] != v[y]; break;
+        case 0xE000:
+            if (v[x] > 0xF || (nn != 0x9E && nn != 0xA1))
+                return false; // Fails
+            skip = (_key[v[x]] != 0) == (nn == 0x9E);
+            break;
+        case 0xF000:
+            if (nn != 0x07)
+                return false; // Fails
+            v[x] = _delayTimer;
+            break;
+        default:
+            return false; // Fails
         }
-    } break;
-    default: printf("Unknown opcode: 0x%04X\n", _opcode); break;
+
+        // Skipped instructions aren't run, so they can be anything
+        if ((opcode & 0xF000) == 0x1000)
+            pc = opcode & 0x0FFF;
+        else
+            pc += skip ? 4 : 2;
+        lastOpcode = opcode;
+        length++;
+    } while (pc != _pc);
+
+    return true;
+}
+
+bool CPU::EndsBlock(u16 opcode)
+{
+    switch (opcode & 0xF000)
+    {
+    case 0x0000: return opcode == 0x00EE;
+    case 0x1000:
+    case 0x2000:
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000:
+    case 0xB000:
+    case 0xD000:
+    case 0xE000:
+        return true;
+    case 0xF000:
+    {
+        const u8 nn = opcode & 0x00FF;
+        return nn == 0x0A || nn == 0x33 || nn == 0x55;
+    }
+    }
+
+    return false;
+}
+
+void CPU::BuildBlock(u16 addr)
+{
+    if (_blockOps.size() + MAX_BLOCK_LENGTH > MAX_BLOCK_OPS)
+        FlushBlocks();
+
+    Block& block = _blocks[addr];
+    block.first = (u32)_blockOps.size();
+    block.length = 0;
+
+    u16 pc = addr;
+    while (block.length < MAX_BLOCK_LENGTH && pc < _memory.size())
+    {
+        const u16 opcode = PeekOpcode(pc);
+        _blockOps.push_back(MakeInstruction(opcode, _dispatchTable[DispatchIndex(opcode)]));
+        _blockCode[pc] = true;
+        block.length++;
+        pc += 2;
+
+        if (EndsBlock(opcode))
+            break;
+    }
+}
+
+void CPU::BindStaticProgram(const StaticProgram* program)
+{
+    _staticProgram = program;
+    _staticBlocks.fill(nullptr);
+    _staticCode.reset();
+
+    if (!program)
+        return;
+
+    for (size_t i = 0; i < program->blockCount; i++)
+    {
+        const StaticBlock& block = program->blocks[i];
+        _staticBlocks[block.addr] = &block;
+
+        for (u16 n = 0; n < block.length; n++)
+            _staticCode[block.addr + n * 2] = true;
+    }
+}
+
+void CPU::FlushBlocks()
+{
+    _blocks.fill({});
+    _blockOps.clear();
+    _blockCode.reset();
+}
+
+u32 CPU::RunBlock(u32 budget)
+{
+    // BNNN can jump past 0xFFF; wrap like the idle table so every PC maps
+    // to a block, and a block always holds at least one instruction
+    _pc &= 0xFFF;
+
+    if (!_blocks[_pc].length)
+        BuildBlock(_pc);
+
+    const Block& block = _blocks[_pc];
+    const Instruction* ops = &_blockOps[block.first];
+    const u32 count = std::min<u32>(block.length, budget);
+
+    // Only the last instruction of a block can branch or write memory,
+    // so PC simply walks forward until then.
+    for (u32 i = 0; i < count; i++)
+    {
+        _inst = &ops[i];
+        _opcode = _inst->opcode;
+        _pc += 2;
+
+        (this->*_inst->handler)();
     }
+
+    return count;
 }
 
+u32 CPU::RunJit(u32 budget)
+{
+    _pc &= 0xFFF;
+
+    const Jit::Translation& block = _jit.Lookup(*this, _pc, FONTSET_START_ADDRESS);
+
+    if (block.fn && block.length <= budget)
+    {
+        block.fn(this);
+        return block.length;
+    }
+
+    Fetch();
+    Decode();
+    Execute();
+
+    return 1;
+}
+
+u32 CPU::RunStatic(u32 budget)
+{
+    _pc &= 0xFFF;
+
+    const StaticBlock* block = _staticBlocks[_pc];
+
+    if (block && block->length <= budget)
+    {
+        block->fn(*this);
+        return block->length;
+    }
+
+    Fetch();
+    Decode();
+    Execute();
+
+    return 1;
+}
+
+#if CHIP8_THREADED_DISPATCH
+u32 CPU::RunThreaded(u32 budget)
+{
+    // Label addresses only exist inside this function, so map the shared
+    // handler table onto them here, once.
+    static const std::pair<OpHandler, void*> targets[] =
+    {
+        { &CPU::OP_0NNN, &&L_0NNN }, { &CPU::OP_00E0, &&L_00E0 }, { &CPU::OP_00EE, &&L_00EE },
+        { &CPU::OP_1NNN, &&L_1NNN }, { &CPU::OP_2NNN, &&L_2NNN }, { &CPU::OP_3XNN, &&L_3XNN },
+        { &CPU::OP_4XNN, &&L_4XNN }, { &CPU::OP_5XY0, &&L_5XY0 }, { &CPU::OP_6XNN, &&L_6XNN },
+        { &CPU::OP_7XNN, &&L_7XNN }, { &CPU::OP_8XY0, &&L_8XY0 }, { &CPU::OP_8XY1, &&L_8XY1 },
+        { &CPU::OP_8XY2, &&L_8XY2 }, { &CPU::OP_8XY3, &&L_8XY3 }, { &CPU::OP_8XY4, &&L_8XY4 },
+        { &CPU::OP_8XY5, &&L_8XY5 }, { &CPU::OP_8XY6, &&L_8XY6 }, { &CPU::OP_8XY7, &&L_8XY7 },
+        { &CPU::OP_8XYE, &&L_8XYE }, { &CPU::OP_9XY0, &&L_9XY0 }, { &CPU::OP_ANNN, &&L_ANNN },
+        { &CPU::OP_BNNN, &&L_BNNN }, { &CPU::OP_CXNN, &&L_CXNN }, { &CPU::OP_DXYN, &&L_DXYN },
+        { &CPU::OP_EX9E, &&L_EX9E }, { &CPU::OP_EXA1, &&L_EXA1 }, { &CPU::OP_FX07, &&L_FX07 },
+        { &CPU::OP_FX0A, &&L_FX0A }, { &CPU::OP_FX15, &&L_FX15 }, { &CPU::OP_FX18, &&L_FX18 },
+        { &CPU::OP_FX1E, &&L_FX1E }, { &CPU::OP_FX29, &&L_FX29 }, { &CPU::OP_FX33, &&L_FX33 },
+        { &CPU::OP_FX55, &&L_FX55 }, { &CPU::OP_FX65, &&L_FX65 }, { &CPU::OP_NULL, &&L_NULL }
+    };
+
+    static const std::array<void*, 16 * 256> labels = []
+        {
+            std::array<void*, 16 * 256> table{};
+            for (size_t i = 0; i < table.size(); i++)
+            {
+                for (const auto& [handler, label] : targets)
+                {
+                    if (_dispatchTable[i] == handler)
+                        table[i] = label;
+                }
+            }
+            return table;
+        }();
+
+    u32 remaining = budget;
+
+    // Fetch and decode of the next instruction, repeated at the tail of every handler
+    // so each one gets its own indirect branch.
+#define CHIP8_DISPATCH()                    \
+    if (remaining == 0)                     \
+        return budget;                      \
+    remaining--;                            \
+    _pc &= 0xFFF;                           \
+    if (!_icache[_pc].handler)              \
+        Predecode(_pc);                     \
+    _inst = &_icache[_pc];                  \
+    _opcode = _inst->opcode;                \
+    _pc += 2;                               \
+    goto *labels[DispatchIndex(_opcode)]
+
+#define CHIP8_OP(name) L_##name: OP_##name(); CHIP8_DISPATCH();
+
+    CHIP8_DISPATCH();
+
+    // Halted, the rest of the budget would only spin on FX0A
+L_FX0A:
+    OP_FX0A();
+    if (IsWaitingForKey())
+        return budget - remaining;
+    CHIP8_DISPATCH();
+
+    CHIP8_OP(0NNN) CHIP8_OP(00E0) CHIP8_OP(00EE) CHIP8_OP(1NNN) CHIP8_OP(2NNN) CHIP8_OP(3XNN)
+    CHIP8_OP(4XNN) CHIP8_OP(5XY0) CHIP8_OP(6XNN) CHIP8_OP(7XNN) CHIP8_OP(8XY0) CHIP8_OP(8XY1)
+    CHIP8_OP(8XY2) CHIP8_OP(8XY3) CHIP8_OP(8XY4) CHIP8_OP(8XY5) CHIP8_OP(8XY6) CHIP8_OP(8XY7)
+    CHIP8_OP(8XYE) CHIP8_OP(9XY0) CHIP8_OP(ANNN) CHIP8_OP(BNNN) CHIP8_OP(CXNN) CHIP8_OP(DXYN)
+    CHIP8_OP(EX9E) CHIP8_OP(EXA1) CHIP8_OP(FX07) CHIP8_OP(FX15) CHIP8_OP(FX18)
+    CHIP8_OP(FX1E) CHIP8_OP(FX29) CHIP8_OP(FX33) CHIP8_OP(FX55) CHIP8_OP(FX65) CHIP8_OP(NULL)
+
+#undef CHIP8_OP
+#undef CHIP8_DISPATCH
+}
+#else
+u32 CPU::RunThreaded(u32 budget)
+{
+    u32 i = 0;
+    for (; i < budget && !IsWaitingForKey(); i++)
+    {
+        Fetch();
+        Decode();
+        Execute();
+    }
+
+    return i;
+}
+#endif
+
 void CPU::UpdateTimers()
 {
     if (_delayTimer > 0)
         _delayTimer--;
 
     if (_soundTimer > 0)
-    {
-        _beep(440, 100);
         _soundTimer--;
-    }
 }
 
 void CPU::Reset(std::vector<char> rom, size_t romSize)
@@ -107,20 +539,27 @@ void CPU::Reset(std::vector<char> rom, size_t romSize)
     _index = 0;
     _sp = 0;
 
-    _addr = 0x0;
-    _byte = 0x0;
-    _x = 0x0;
-    _y = 0x0;
+    _inst = &_decoded;
 
     _delayTimer = 0;
     _soundTimer = 0;
 
+    _keyWait = KeyWait::None;
+    _keyWaitKey = 0;
+
+    _unknownOpcodes = 0;
+
     Clear(_key);
     Clear(_screen);
+    MarkDirty(ALL_ROWS);
     Clear(_stack);
     Clear(_registers);
     Clear(_memory);
 
+    _icache.fill({});
+    FlushBlocks();
+    _jit.Flush();
+
     // Load Font
     for (i32 i = 0; i < std::size(_fontset); i++)
         _memory[FONTSET_START_ADDRESS + i] = _fontset[i];
@@ -128,11 +567,97 @@ void CPU::Reset(std::vector<char> rom, size_t romSize)
     // Reload ROM
     if (romSize)
         std::copy(rom.begin(), rom.end(), _memory.begin() + START_ADDRESS);
+
+    _romProgram = romSize ? StaticProgram::Find(reinterpret_cast<const u8*>(rom.data()), romSize) : nullptr;
+    BindStaticProgram(_romProgram);
+}
+
+void CPU::KeyDown(u8 hex)
+{
+    if (hex >= 16)
+        return;
+
+    _key[hex] = 1;
+    if (_keyWait == KeyWait::Press)
+    {
+        _keyWait = KeyWait::Release;
+        _keyWaitKey = hex;
+    }
 }
 
-std::string CPU::Disassemble(u16 addr) const
+void CPU::KeyUp(u8 hex)
+{
+    if (hex >= 16)
+        return;
+
+    _key[hex] = 0;
+    if (_keyWait == KeyWait::Release && _keyWaitKey == hex)
+        _keyWait = KeyWait::Done;
+}
+
+void CPU::SaveState(CPUSnapshot& out) const
+{
+    out.state = *this;
+    out.random = _random;
+}
+
+void CPU::LoadState(const CPUSnapshot& in)
+{
+    // Snapshots of the same ROM mostly differ in data, so keep whatever was decoded from bytes that didn't change
+    const u8* next = in.state._memory.data();
+    for (u32 a = 0; a < _memory.size();)
+    {
+        if (_memory[a] == next[a])
+        {
+            a++;
+            continue;
+        }
+
+        u32 end = a + 1;
+        while (end < _memory.size() && _memory[end] != next[end])
+            end++;
+
+        InvalidateCode((u16)a, (u16)(end - a));
+        a = end;
+    }
+
+    u64 changedRows = 0;
+    for (i32 y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        if (_screen[y] != in.state._screen[y])
+            changedRows |= 1ull << y;
+    }
+
+    static_cast<CPUState&>(*this) = in.state;
+    _random = in.random;
+    _inst = &_decoded;
+
+    // Back to the ahead of time code if the ROM it was built from is intact again
+    if (_romProgram && !_staticProgram && std::equal(_romProgram->rom, _romProgram->rom + _romProgram->romSize, _memory.begin() + START_ADDRESS))
+        BindStaticProgram(_romProgram);
+
+    MarkDirty(changedRows);
+}
+
+u64 CPU::HashPlane() const
+{
+    u64 hash = 1469598103934665603ull;
+    for (const u64 row : _screen)
+    {
+        hash ^= row;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+const u32* CPU::GetPixelData() const
+{
+    PixelExpander::Expand(_screen.data(), SCREEN_WIDTH, 0, SCREEN_HEIGHT, Palette{}, _pixels.data());
+    return _pixels.data();
+}
+
+std::string CPU::DisassembleOpcode(u16 op)
 {
-    const u16 op = PeekOpcode(addr);
     const u16 nnn = op & 0x0FFF;
     const u8  nn = u8(op & 0x00FF);
     const u8  n = u8(op & 0x000F);
@@ -217,7 +742,13 @@ void CPU::OP_0NNN()
 
 void CPU::OP_00E0()
 {
+    // Rows that were already blank need no upload
+    u64 dirty = 0;
+    for (i32 y = 0; y < SCREEN_HEIGHT; y++)
+        dirty |= (u64)(_screen[y] != 0) << y;
+
     Clear(_screen);
+    MarkDirty(dirty);
 }
 
 void CPU::OP_00EE()
@@ -228,159 +759,153 @@ void CPU::OP_00EE()
 
 void CPU::OP_1NNN()
 {
-    _pc = _addr;
+    _pc = NNN();
 }
 
 void CPU::OP_2NNN()
 {
     _stack[_sp] = _pc;
     _sp++;
-    _pc = _addr;
+    _pc = NNN();
 }
 
 void CPU::OP_3XNN()
 {
-    if (_registers[_x] == _byte)
+    if (_registers[X()] == NN())
         _pc += 2;
 }
 
 void CPU::OP_4XNN()
 {
-    if (_registers[_x] != _byte)
+    if (_registers[X()] != NN())
         _pc += 2;
 }
 
 void CPU::OP_5XY0()
 {
-    if (_registers[_x] == _registers[_y])
+    if (_registers[X()] == _registers[Y()])
         _pc += 2;
 }
 
 void CPU::OP_6XNN()
 {
-    _registers[_x] = _byte;
+    _registers[X()] = NN();
 }
 
 void CPU::OP_7XNN()
 {
-    _registers[_x] += _byte;
+    _registers[X()] += NN();
 }
 
 void CPU::OP_8XY0()
 {
-    _registers[_x] = _registers[_y];
+    _registers[X()] = _registers[Y()];
 }
 
 void CPU::OP_8XY1()
 {
-    _registers[_x] |= _registers[_y];
+    _registers[X()] |= _registers[Y()];
 }
 
 void CPU::OP_8XY2()
 {
-    _registers[_x] &= _registers[_y];
+    _registers[X()] &= _registers[Y()];
 }
 
 void CPU::OP_8XY3()
 {
-    _registers[_x] ^= _registers[_y];
+    _registers[X()] ^= _registers[Y()];
 }
 
 void CPU::OP_8XY4()
 {
-    u16 sum = _registers[_x] + _registers[_y];
+    u16 sum = _registers[X()] + _registers[Y()];
 
     _registers[0xF] = sum > 255 ? 1 : 0;
 
-    _registers[_x] = sum & 0xFF;
+    _registers[X()] = sum & 0xFF;
 }
 
 void CPU::OP_8XY5()
 {
-    _registers[0xF] = _registers[_x] > _registers[_y] ? 1 : 0;
+    _registers[0xF] = _registers[X()] > _registers[Y()] ? 1 : 0;
 
-    _registers[_x] -= _registers[_y];
+    _registers[X()] -= _registers[Y()];
 }
 
 void CPU::OP_8XY6()
 {
-    _registers[0xF] = _registers[_x] & 0x1;
+    _registers[0xF] = _registers[X()] & 0x1;
 
-    _registers[_x] >>= 1;
+    _registers[X()] >>= 1;
 }
 
 void CPU::OP_8XY7()
 {
-    _registers[0xF] = _registers[_y] > _registers[_x] ? 1 : 0;
+    _registers[0xF] = _registers[Y()] > _registers[X()] ? 1 : 0;
 
-    _registers[_x] = _registers[_y] - _registers[_x];
+    _registers[X()] = _registers[Y()] - _registers[X()];
 }
 
 void CPU::OP_8XYE()
 {
-    _registers[0xF] = (_registers[_x] & 0x80) >> 7;
+    _registers[0xF] = (_registers[X()] & 0x80) >> 7;
 
-    _registers[_x] <<= 1;
+    _registers[X()] <<= 1;
 }
 
 void CPU::OP_9XY0()
 {
-    if (_registers[_x] != _registers[_y])
+    if (_registers[X()] != _registers[Y()])
         _pc += 2;
 }
 
 void CPU::OP_ANNN()
 {
-    _index = _addr;
+    _index = NNN();
 }
 
 void CPU::OP_BNNN()
 {
-    _pc = _registers[0] + _addr;
+    _pc = _registers[0] + NNN();
 }
 
 void CPU::OP_CXNN()
 {
-    _registers[_x] = _dist(_engine) & _byte;
+    _registers[X()] = _random.NextByte() & NN();
 }
 
 void CPU::OP_DXYN()
 {
-    u8 height = _opcode & 0x000F;
+    u8 height = N();
 
-    u8 xPos = _registers[_x] & 63;
-    u8 yPos = _registers[_y] & 31;
+    u8 xPos = _registers[X()] & 63;
+    u8 yPos = _registers[Y()] & 31;
 
     _registers[0xF] = 0;
 
+    u64 dirty = 0;
     for (u32 row = 0; row < height; row++)
     {
-        u8 spriteByte = _memory[_index + row];
-
-        for (u32 col = 0; col < 8; col++)
-        {
-            u8 spritePixel = spriteByte & (0x80 >> col);
+        // Rotating rather than shifting wraps the sprite around the right edge
+        u64 sprite = std::rotr((u64)_memory[_index + row] << 56, xPos);
 
-            u32 x = (xPos + col) & 63;
-            u32 y = (yPos + row) & 31;
-            u32 i = y * 64 + x;
+        const u32 y = (yPos + row) & 31;
+        u64& line = _screen[y];
 
-            u32* screenPixel = &_screen[i];
+        if (line & sprite)
+            _registers[0xF] = 1;
 
-            if (spritePixel)
-            {
-                if (*screenPixel == 0xFFFFFFFF)
-                    _registers[0xF] = 1;
-
-                *screenPixel ^= 0xFFFFFFFF;
-            }
-        }
+        line ^= sprite;
+        dirty |= (u64)(sprite != 0) << y;
     }
+
+    MarkDirty(dirty);
 }
 
 void CPU::OP_EX9E()
 {
-    u8 key = _registers[_x];
+    u8 key = _registers[X()];
 
     if (_key[key])
         _pc += 2;
@@ -388,7 +913,7 @@ void CPU::OP_EX9E()
 
 void CPU::OP_EXA1()
 {
-    u8 key = _registers[_x];
+    u8 key = _registers[X()];
 
     if (!_key[key])
         _pc += 2;
@@ -396,47 +921,48 @@ void CPU::OP_EXA1()
 
 void CPU::OP_FX07()
 {
-    _registers[_x] = _delayTimer;
+    _registers[X()] = _delayTimer;
 }
 
 void CPU::OP_FX0A()
 {
-    for (u8 k = 0; k < 16; k++)
+    if (_keyWait == KeyWait::Done)
     {
-        if (_key[k])
-        {
-            _registers[_x] = k;
-            return;
-        }
+        _registers[X()] = _keyWaitKey;
+        _keyWait = KeyWait::None;
+        return;
     }
 
+    // Keys already held don't count, it takes a fresh press. KeyDown and KeyUp do the rest.
+    if (_keyWait == KeyWait::None)
+        _keyWait = KeyWait::Press;
     _pc -= 2;
 }
 
 void CPU::OP_FX15()
 {
-    _delayTimer = _registers[_x];
+    _delayTimer = _registers[X()];
 }
 
 void CPU::OP_FX18()
 {
-    _soundTimer = _registers[_x];
+    _soundTimer = _registers[X()];
 }
 
 void CPU::OP_FX1E()
 {
-    _index += _registers[_x];
+    _index += _registers[X()];
 }
 
 void CPU::OP_FX29()
 {
-    u8 value = _registers[_x];
+    u8 value = _registers[X()];
     _index = FONTSET_START_ADDRESS + (5 * value);
 }
 
 void CPU::OP_FX33()
 {
-    u8 value = _registers[_x];
+    u8 value = _registers[X()];
 
     _memory[_index + 2] = value % 10;
     value /= 10;
@@ -445,16 +971,27 @@ void CPU::OP_FX33()
     value /= 10;
 
     _memory[_index] = value % 10;
+
+    InvalidateCode(_index, 3);
 }
 
 void CPU::OP_FX55()
 {
-    for (u8 i = 0; i <= _x; i++)
+    for (u8 i = 0; i <= X(); i++)
         _memory[_index + i] = _registers[i];
+
+    InvalidateCode(_index, X() + 1);
 }
 
 void CPU::OP_FX65()
 {
-    for (u8 i = 0; i <= _x; i++)
+    for (u8 i = 0; i <= X(); i++)
         _registers[i] = _memory[_index + i];
+}
+
+void CPU::OP_NULL()
+{
+    // A ROM that hits one usually hits it every frame, so only the first gets printed
+    if (_unknownOpcodes++ == 0)
+        printf("Unknown opcode: 0x%04X at 0x%03X\n", _opcode, _pc - 2);
 }
\ No newline at end of file
@@ -1,49 +1,133 @@
 #pragma once
 
 #include "Types.h"
+#include "CPUState.h"
+#include "Jit.h"
+#include "Snapshot.h"
+#include "StaticProgram.h"
+#include "Random.h"
 
 #include <array>
+#include <bitset>
 #include <random>
+#include <string>
 #include <vector>
 
-class CPU
+// Labels as values, needed by the threaded interpreter, are a GCC/Clang extension
+#if defined(__GNUC__)
+#define CHIP8_THREADED_DISPATCH 1
+#else
+#define CHIP8_THREADED_DISPATCH 0
+#endif
+
+enum class DispatchMode : u8
+{
+    Switch, // Nested switch on the opcode nibbles
+    Table,  // Precomputed 16x256 handler table
+    Cached, // Predecoded instructions keyed by PC
+    Block,  // Predecoded basic blocks, executed a whole block per dispatch
+    Jit,    // Basic blocks recompiled to native code where possible
+    Static, // Blocks recompiled ahead of time by Chip8Recompiler, if the ROM has them
+    Threaded // Computed goto between handlers, the next dispatch folded into each handler
+};
+
+// Looks up a mode by its lower case name, "switch" through "threaded". Fails on an unknown name.
+bool DispatchModeFromName(const char* name, DispatchMode& mode);
+
+class CPU : private CPUState
 {
 public:
     void Fetch();
     void Decode();
     void Execute();
+
+    // Called by Chip8 at 60 Hz of emulated time, not per instruction
     void UpdateTimers();
 
+    // Executes the basic block at PC, at most budget instructions of it. Returns the instructions executed.
+    u32 RunBlock(u32 budget);
+
+    // Executes the recompiled block at PC, branch included, if it fits the budget, otherwise a single interpreted instruction.
+    u32 RunJit(u32 budget);
+
+    // Executes the ahead of time block at PC if it fits the budget, otherwise a single interpreted instruction.
+    u32 RunStatic(u32 budget);
+
+    // Executes budget instructions with threaded dispatch, or the predecoded loop where that isn't compiled in.
+    // Stops early once FX0A halts, returns the instructions executed.
+    u32 RunThreaded(u32 budget);
+    static constexpr bool HasThreadedDispatch() { return CHIP8_THREADED_DISPATCH; }
+
+    // If PC is in a loop that only waits on the delay timer or the keypad, accounts for as
+    // many whole laps of it as fit in budget and returns how many instructions that was.
+    // Those laps change nothing but the registers the first one loads, so they aren't run.
+    // The budget must not cross a timer tick or a key change.
+    u32 SkipIdleLoop(u32 budget);
+
+    void SeedRandom(u32 seed) { _random.Seed(seed); }
+
     void Reset(std::vector<char> rom, size_t romSize);
 
-    std::string Disassemble(u16 addr) const;
+    std::string Disassemble(u16 addr) const { return DisassembleOpcode(PeekOpcode(addr)); }
+    static std::string DisassembleOpcode(u16 opcode);
 
 private:
     u16 START_ADDRESS = 0x200;
-    std::array<u8, 4096> _memory{};
-    std::array<u8, 16> _registers{};
-    std::array<u8, 16> _key{};
-    std::array<u16, 16> _stack{};
 
-    std::array<u32, 64 * 32> _screen{};
+    using OpHandler = void (CPU::*)();
+
+    struct Instruction
+    {
+        OpHandler handler = nullptr;
+        u16 opcode = 0;
+        u16 nnn = 0; // Lowest 12 bits
+        u8 nn = 0; // Lowest 8 bits
+        u8 n = 0; // Lowest 4 bits
+        u8 x = 0; // Lower 4 bits of high byte
+        u8 y = 0; // Upper 4 bits of low byte
+    };
+
+    DispatchMode _dispatchMode = DispatchMode::Cached;
+    u32 _unknownOpcodes = 0; // Since the last reset
 
-    u16 _opcode;
-    u16 _index;
-    u16 _pc;
-    u16 _sp;
+    const Instruction* _inst = &_decoded;
+    Instruction _decoded{};
+
+    // One entry per PC, an entry covers the bytes at pc and pc + 1
+    std::array<Instruction, 4096> _icache{};
+
+    struct Block
+    {
+        u32 first = 0; // Index into _blockOps
+        u16 length = 0; // Instructions, 0 if not built yet
+    };
 
-    u16 _addr; // Lowest 12 bits
-    u8 _byte; // Lowest 8 bits
-    u16 _hNibble; // Highest 4 bits
-    u16 _lNibble; // Lowest 4 bits
-    u8 _x; // Lower 4 bits of high byte
-    u8 _y; // Upper 4 bits of low byte
+    static constexpr u16 MAX_BLOCK_LENGTH = 64;
+    static constexpr size_t MAX_BLOCK_OPS = 64 * 1024;
 
-    u8 _delayTimer;
-    u8 _soundTimer;
+    std::array<Block, 4096> _blocks{};
+    std::vector<Instruction> _blockOps;
+    std::bitset<4096> _blockCode; // Addresses decoded into any block
 
-    std::mt19937 _engine{ std::random_device{}() };
-    std::uniform_int_distribution<u16> _dist{ 0, 255 };
+    // Indexed by (opcode & 0xF000) >> 4 | (opcode & 0x00FF), see DispatchIndex()
+    static const std::array<OpHandler, 16 * 256> _dispatchTable;
+
+    Jit _jit;
+
+    const StaticProgram* _staticProgram = nullptr;
+    const StaticProgram* _romProgram = nullptr; // Found for the ROM at the last reset, bound or not
+    std::array<const StaticBlock*, 4096> _staticBlocks{};
+    std::bitset<4096> _staticCode; // Instruction addresses covered by any static block
+
+    Random _random{ std::random_device{}() };
+
+    // Bit y is set when row y may have changed since the frontend last looked.
+    // Everything starts dirty as nothing has been uploaded yet.
+    u64 _dirtyRows = ALL_ROWS;
+    u32 _displayGeneration = 0;
+
+    // RGBA expansion of _screen, only filled in when asked for
+    mutable std::array<u32, 64 * 32> _pixels{};
 
     u16 FONTSET_START_ADDRESS = 0x50;
     u8 _fontset[80] =
@@ -67,12 +151,35 @@ private:
     };
 
 public:
-    const u32* GetPixelData() const { return _screen.data(); }
+    static constexpr i32 SCREEN_WIDTH = 64;
+    static constexpr i32 SCREEN_HEIGHT = 32;
+    static constexpr u64 ALL_ROWS = ~0ull >> (64 - SCREEN_HEIGHT);
+
+    const CPUState& GetState() const { return *this; }
+
+    void SaveState(CPUSnapshot& out) const;
+    // Only the code caches covering bytes that differ from the current memory are dropped
+    void LoadState(const CPUSnapshot& in);
+
+    // 1 bit per pixel, one word per row, see PixelExpander
+    const u64* GetPlane() const { return _screen.data(); }
+    // FNV-1a over the plane rows, a cheap fingerprint for comparing runs
+    u64 HashPlane() const;
+
+    // Bumped whenever a row of the plane may have changed
+    const u32 GetDisplayGeneration() const { return _displayGeneration; }
+    // Rows touched since the last call, bit y for row y
+    u64 ConsumeDirtyRows() { const u64 rows = _dirtyRows; _dirtyRows = 0; return rows; }
+    const u32* GetPixelData() const;
 
-    void KeyDown(u8 hex) { if (hex < 16) _key[hex] = 1; }
-    void KeyUp(u8 hex) { if (hex < 16) _key[hex] = 0; }
+    // Also what moves a halted FX0A along, see KeyWait
+    void KeyDown(u8 hex);
+    void KeyUp(u8 hex);
     const bool IsKeyDown(u8 hex) const { return _key[hex] == 1; }
 
+    // Halted on FX0A: until a key event arrives, running it again would only spin in place
+    bool IsWaitingForKey() const { return _keyWait == KeyWait::Press || _keyWait == KeyWait::Release; }
+
     const u8 GetDelayTimer() const { return _delayTimer; }
     void SetDelayTimer(u8 timer) { _delayTimer = timer; }
     void DecrementDelayTimer() { _delayTimer--; }
@@ -99,11 +206,46 @@ public:
     const u8 GetVRegister(u8 reg) const { return _registers[reg]; }
     const u16 GetIndex() const { return _index; }
 
+    const StaticProgram* GetStaticProgram() const { return _staticProgram; }
+    const u32 GetUnknownOpcodes() const { return _unknownOpcodes; }
+
+    DispatchMode GetDispatchMode() const { return _dispatchMode; }
+    void SetDispatchMode(DispatchMode mode) { _dispatchMode = mode; }
+
     // Util Helper
     template <typename T, size_t S>
     void Clear(std::array<T, S>& arr) { std::fill(std::begin(arr), std::end(arr), 0); }
 
 private:
+    static u16 DispatchIndex(u16 opcode) { return ((opcode & 0xF000) >> 4) | (opcode & 0x00FF); }
+    static OpHandler DecodeSwitch(u16 opcode);
+    static std::array<OpHandler, 16 * 256> BuildDispatchTable();
+
+    static Instruction MakeInstruction(u16 opcode, OpHandler handler);
+    void Predecode(u16 addr);
+    void InvalidateCode(u16 addr, u16 length);
+    void MarkDirty(u64 rows) { if (rows) { _dirtyRows |= rows; _displayGeneration++; } }
+
+    // Walks one lap of the loop at PC on a copy of the registers. Fails unless it gets back
+    // to PC within MAX_IDLE_LOOP instructions, running nothing but FX07, skips and jumps.
+    bool IdleLap(std::array<u8, 16>& v, u32& length, u16& lastOpcode) const;
+    static constexpr u32 MAX_IDLE_LOOP = 16;
+    static constexpr u8 IDLE_BACKOFF = 15;
+    std::array<u8, 4096> _idleBackoff{}; // Chunks left before SkipIdleLoop looks at a PC again
+
+    static bool EndsBlock(u16 opcode);
+    void BuildBlock(u16 addr);
+    void FlushBlocks();
+
+    void BindStaticProgram(const StaticProgram* program);
+
+    // Operands of the instruction being executed
+    u16 NNN() const { return _inst->nnn; }
+    u8 NN() const { return _inst->nn; }
+    u8 N() const { return _inst->n; }
+    u8 X() const { return _inst->x; }
+    u8 Y() const { return _inst->y; }
+
     //Instructions:
     void OP_0NNN();
     void OP_00E0();
@@ -140,4 +282,5 @@ private:
     void OP_FX33();
     void OP_FX55();
     void OP_FX65();
+    void OP_NULL();
 };
\ No newline at end of file
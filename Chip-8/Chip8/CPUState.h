@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Types.h"
+
+#include <array>
+
+// Progress of an FX0A, which waits for a key to be pressed and then released
+enum class KeyWait : u8
+{
+    None,
+    Press,   // Halted until any key goes down
+    Release, // Halted until _keyWaitKey comes back up
+    Done     // Released, the next FX0A stores _keyWaitKey and moves on
+};
+
+// Architectural state of the CPU. Kept as one standard-layout struct so that
+// generated code can address every field at a fixed offset from a single pointer.
+struct CPUState
+{
+    std::array<u8, 4096> _memory{};
+    std::array<u8, 16> _registers{};
+    std::array<u8, 16> _key{};
+    std::array<u16, 16> _stack{};
+
+    std::array<u64, 32> _screen{}; // One bit per pixel, bit 63 is the leftmost column
+
+    u16 _opcode = 0;
+    u16 _index = 0;
+    u16 _pc = 0;
+    u16 _sp = 0;
+
+    u8 _delayTimer = 0;
+    u8 _soundTimer = 0;
+
+    KeyWait _keyWait = KeyWait::None;
+    u8 _keyWaitKey = 0;
+};
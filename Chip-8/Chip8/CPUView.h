@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Types.h"
+#include "CPU.h"
+
+#include <string>
+
+// Read-only stand-in for CPU over a CPUState snapshot, with the same getters,
+// so the frontend can inspect a CPU that another thread is running.
+class CPUView
+{
+public:
+    void Bind(const CPUState* state, DispatchMode mode, const StaticProgram* program)
+    {
+        _state = state;
+        _dispatchMode = mode;
+        _staticProgram = program;
+    }
+
+    const u64* GetPlane() const { return _state->_screen.data(); }
+
+    const bool IsKeyDown(u8 hex) const { return _state->_key[hex] == 1; }
+
+    const u8 GetDelayTimer() const { return _state->_delayTimer; }
+    const u8 GetSoundTimer() const { return _state->_soundTimer; }
+
+    const u16 PeekOpcode(u16 addr) const { if (addr >= _state->_memory.size() - 1) return 0; return _state->_memory[addr] << 8 | _state->_memory[addr + 1]; }
+    const u16 GetOpcode() const { return _state->_opcode; }
+
+    const size_t GetMemorySize() const { return _state->_memory.size(); }
+    const u8* GetMemory() const { return _state->_memory.data(); }
+
+    const u16 GetPC() const { return _state->_pc; }
+    const u16* GetStack() const { return _state->_stack.data(); }
+    const u16 GetSP() const { return _state->_sp; }
+
+    const u8 GetVRegister(u8 reg) const { return _state->_registers[reg]; }
+    const u16 GetIndex() const { return _state->_index; }
+
+    const StaticProgram* GetStaticProgram() const { return _staticProgram; }
+    DispatchMode GetDispatchMode() const { return _dispatchMode; }
+
+    std::string Disassemble(u16 addr) const { return CPU::DisassembleOpcode(PeekOpcode(addr)); }
+
+private:
+    const CPUState* _state = nullptr;
+    DispatchMode _dispatchMode = DispatchMode::Cached;
+    const StaticProgram* _staticProgram = nullptr;
+};
@@ -1,61 +1,255 @@
 #include "Chip8.h"
 
+#include "AudioSink.h"
+#include "InputScript.h"
+
 #include <filesystem>
 #include <fstream>
+#include <random>
 
 Chip8::Chip8()
 {
     Init();
 }
 
-void Chip8::Cycle()
+Chip8::~Chip8()
+{
+    delete _cpu;
+}
+
+void Chip8::Cycle(f64 elapsed)
 {
     if (_paused)
     {
         if (_doStep)
         {
-            SingleCycle();
+            RunCycles(1);
             _doStep = false;
         }
     }
+    else if (_clockMode == ClockMode::InstructionsPerSecond)
+        RunCycles(TakeDueCycles(elapsed));
     else
+        RunCycles(_cyclesPerFrame);
+}
+
+void Chip8::SetClockMode(ClockMode mode)
+{
+    _clockMode = mode;
+    _cyclesDue = 0.0;
+}
+
+u32 Chip8::TakeDueCycles(f64 elapsed)
+{
+    _cyclesDue += std::max(0.0, elapsed) * _instructionsPerSecond;
+
+    // Too far behind to catch up, most likely the host can't keep up with the rate. Running all of it
+    // would only take longer still, so the emulation slows down instead.
+    const f64 limit = MAX_CATCHUP_SECONDS * _instructionsPerSecond;
+    if (_cyclesDue > limit)
     {
-        for (i32 i = 0; i < _cyclesPerFrame; i++)
-            SingleCycle();
+        _droppedCycles += (u64)(_cyclesDue - limit);
+        _cyclesDue = limit;
     }
+
+    const u32 count = (u32)_cyclesDue;
+    _cyclesDue -= count;
+    return count;
 }
 
-void Chip8::LoadROM(std::string_view filePath)
+bool Chip8::LoadROM(std::string_view filePath)
 {
     std::ifstream file(std::string(filePath), std::ios::binary | std::ios::ate);
 
     if (!file)
-        return; // Fails
+        return false; // Fails
 
     const std::streamsize size = file.tellg();
     if (size <= 0)
-        return; // Fails
-    if (_cpu->GetStartAddress() + static_cast<size_t>(size) > _cpu->GetMemorySize())
-        return; // Fails
-
-    _currentRom.resize(size);
-    _currRomSize = size;
+        return false; // Fails
 
+    std::vector<u8> data(size);
     file.seekg(0, std::ios::beg);
-    file.read(_currentRom.data(), size);
+    if (!file.read(reinterpret_cast<char*>(data.data()), size))
+        return false; // Fails
 
-    Reset();
+    return LoadROM(data.data(), data.size());
+}
+
+bool Chip8::LoadROM(const u8* data, size_t size)
+{
+    if (!data || size == 0)
+        return false; // Fails
+    if (_cpu->GetStartAddress() + size > _cpu->GetMemorySize())
+        return false; // Fails
+
+    _currentRom.assign(data, data + size);
+    _currRomSize = size;
+
+    Boot();
+    return true;
 }
 
 void Chip8::Reset()
 {
-    _cpu->Reset(_currentRom, _currRomSize);
+    LoadState(_boot);
+
+    _idleCycles = 0;
+    _cyclesDue = 0.0;
+    _droppedCycles = 0;
+
+    // The seed may have been set since the boot state was taken. Unseeded, a reset
+    // draws a fresh sequence like a power cycle instead of replaying the boot one.
+    if (_seeded)
+        _cpu->SeedRandom(_seed);
+    else
+        _cpu->SeedRandom(std::random_device{}());
+}
+
+void Chip8::SetSeed(u32 seed)
+{
+    _seeded = true;
+    _seed = seed;
+    _cpu->SeedRandom(seed);
+}
+
+void Chip8::KeyDown(u8 hex)
+{
+    if (_recording)
+        _recording->Add({ _totalCycles, hex, true });
+    _cpu->KeyDown(hex);
+}
+
+void Chip8::KeyUp(u8 hex)
+{
+    if (_recording)
+        _recording->Add({ _totalCycles, hex, false });
+    _cpu->KeyUp(hex);
+}
+
+void Chip8::SaveState(Chip8Snapshot& out) const
+{
+    out.magic = Chip8Snapshot::MAGIC;
+    out.version = Chip8Snapshot::VERSION;
+    out.size = sizeof(Chip8Snapshot);
+
+    _cpu->SaveState(out.cpu);
+    out.cyclesSinceTick = _cyclesSinceTick;
+    out.totalCycles = _totalCycles;
+    out.timerTicks = _timerTicks;
+}
+
+bool Chip8::LoadState(const Chip8Snapshot& in)
+{
+    if (!in.IsValid())
+        return false; // Fails
+
+    _cpu->LoadState(in.cpu);
+    _cyclesSinceTick = in.cyclesSinceTick;
+    _totalCycles = in.totalCycles;
+    _timerTicks = in.timerTicks;
+    return true;
 }
 
 void Chip8::Init()
 {
     _cpu = new CPU();
+    Boot();
+}
+
+void Chip8::Boot()
+{
+    // The one full rebuild, every later Reset is a restore of this
     _cpu->Reset(_currentRom, _currRomSize);
+
+    _cyclesSinceTick = 0;
+    _totalCycles = 0;
+    _timerTicks = 0;
+    _idleCycles = 0;
+    _cyclesDue = 0.0;
+    _droppedCycles = 0;
+
+    if (_seeded)
+        _cpu->SeedRandom(_seed);
+
+    SaveState(_boot);
+}
+
+void Chip8::RunCycles(u32 count)
+{
+    // Lowering cycles/frame can leave us past the boundary already
+    if (_cyclesSinceTick >= GetFrameLength())
+        TickTimers();
+
+    // Engines run in chunks that end on a timer boundary, so the timers see
+    // the same instruction counts whatever the dispatch mode.
+    while (count)
+    {
+        const u32 chunk = std::min<u32>(count, GetFrameLength() - _cyclesSinceTick);
+
+        // Nothing changes DT or the keys within a chunk, so a wait on them spins for the rest of it.
+        // Halted on FX0A there's nothing to run at all until the next key event, and an
+        // FX0A reached mid-chunk stops the engine there with the remainder left idle.
+        if (_cpu->IsWaitingForKey())
+            _idleCycles += chunk;
+        else
+        {
+            const u32 idle = _idleSkip ? _cpu->SkipIdleLoop(chunk) : 0;
+            const u32 executed = Execute(chunk - idle);
+            _idleCycles += chunk - executed;
+        }
+
+        count -= chunk;
+        _cyclesSinceTick += chunk;
+        _totalCycles += chunk;
+
+        if (_cyclesSinceTick >= GetFrameLength())
+            TickTimers();
+    }
+}
+
+u32 Chip8::GetFrameLength() const
+{
+    if (_clockMode == ClockMode::CyclesPerFrame)
+        return (u32)_cyclesPerFrame;
+
+    // Frame k ends at instruction (k + 1) * rate / 60, so fractions don't accumulate
+    const u64 end = (_timerTicks + 1) * _instructionsPerSecond / TIMER_HZ;
+    const u64 start = _timerTicks * _instructionsPerSecond / TIMER_HZ;
+    return (u32)(end - start);
+}
+
+u32 Chip8::Execute(u32 count)
+{
+    // FX0A always ends a block or translation, so checking between them catches every halt
+    u32 left = count;
+    switch (_cpu->GetDispatchMode())
+    {
+    case DispatchMode::Block:
+        while (left && !_cpu->IsWaitingForKey())
+            left -= _cpu->RunBlock(left);
+        break;
+    case DispatchMode::Jit:
+        while (left && !_cpu->IsWaitingForKey())
+            left -= _cpu->RunJit(left);
+        break;
+    case DispatchMode::Static:
+        while (left && !_cpu->IsWaitingForKey())
+            left -= _cpu->RunStatic(left);
+        break;
+    case DispatchMode::Threaded:
+        left -= _cpu->RunThreaded(left);
+        break;
+    default:
+        while (left && !_cpu->IsWaitingForKey())
+        {
+            SingleCycle();
+            left--;
+        }
+        break;
+    }
+
+    return count - left;
 }
 
 void Chip8::SingleCycle()
@@ -65,6 +259,17 @@ void Chip8::SingleCycle()
     _cpu->Decode();
 
     _cpu->Execute();
+}
 
+void Chip8::TickTimers()
+{
+    // The tone sounds for as many ticks as the sound timer was set to
+    const bool toneOn = _cpu->GetSoundTimer() > 0;
     _cpu->UpdateTimers();
+
+    if (_audio)
+        _audio->Tick(toneOn);
+
+    _cyclesSinceTick = 0;
+    _timerTicks++;
 }
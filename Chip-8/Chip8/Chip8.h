@@ -2,17 +2,55 @@
 
 #include "CPU.h"
 
+#include <algorithm>
 #include <string_view>
 
+class AudioSink;
+class InputScript;
+
+enum class ClockMode : u8
+{
+    CyclesPerFrame,       // A fixed instruction count every 60 Hz frame, however long frames really take
+    InstructionsPerSecond // A target rate, the count per frame worked out from elapsed wall time
+};
+
 class Chip8
 {
 public:
     Chip8();
+    ~Chip8();
+    Chip8(const Chip8&) = delete;
+    Chip8& operator=(const Chip8&) = delete;
 
-    void Cycle();
-    void LoadROM(std::string_view filePath);
+    // One frame's worth. elapsed is the wall time since the last call, only InstructionsPerSecond mode looks at it.
+    void Cycle(f64 elapsed = 1.0 / TIMER_HZ);
+    // Runs count instructions regardless of pause, ticking the timers on frame boundaries
+    void RunCycles(u32 count);
+    bool LoadROM(std::string_view filePath);
+    bool LoadROM(const u8* data, size_t size);
+    // Restores the state captured when the ROM was loaded. The RNG restarts from the seed if
+    // there is one, otherwise it is reseeded from std::random_device.
     void Reset();
 
+    // Deterministic mode: CXNN is seeded with seed now and at every later load and reset,
+    // instead of from std::random_device. With the same input a run then repeats bit for bit.
+    void SetSeed(u32 seed);
+    bool IsSeeded() const { return _seeded; }
+    const u32 GetSeed() const { return _seed; }
+
+    // Keypad input that goes through here is recorded, see SetRecording
+    void KeyDown(u8 hex);
+    void KeyUp(u8 hex);
+    // Not owned, receives every key event keyed by cycle. Null to stop.
+    void SetRecording(InputScript* script) { _recording = script; }
+    bool IsRecording() const { return _recording != nullptr; }
+    // Halted on FX0A until a key is pressed and released. RunCycles only counts the cycles meanwhile.
+    bool IsWaitingForKey() const { return _cpu->IsWaitingForKey(); }
+
+    void SaveState(Chip8Snapshot& out) const;
+    // Fails without touching anything if the snapshot is from another version
+    bool LoadState(const Chip8Snapshot& in);
+
     const CPU* GetCPU() const { return _cpu; }
     CPU* GetCPU() { return _cpu; } // Added for glfw key callbacks
 
@@ -25,16 +63,72 @@ public:
     void SetCyclesPerFrame(i32 n) { _cyclesPerFrame = std::max(1, n); }
     int  GetCyclesPerFrame() const { return _cyclesPerFrame; }
 
+    // Emulated time: the timers tick once every _cyclesPerFrame instructions, which is one 60 Hz frame.
+    // In InstructionsPerSecond mode a frame is instead rate / 60 instructions, spread evenly when that isn't whole.
+    static constexpr u32 TIMER_HZ = 60;
+
+    void SetClockMode(ClockMode mode);
+    ClockMode GetClockMode() const { return _clockMode; }
+    static constexpr u32 MIN_IPS = 500;
+    static constexpr u32 MAX_IPS = 100'000'000;
+    void SetInstructionsPerSecond(u32 ips) { _instructionsPerSecond = std::clamp(ips, MIN_IPS, MAX_IPS); }
+    const u32 GetInstructionsPerSecond() const { return _instructionsPerSecond; }
+
+    // Instructions due after elapsed more seconds in InstructionsPerSecond mode, taken off the backlog.
+    // A backlog beyond MAX_CATCHUP_SECONDS of instructions is dropped rather than run.
+    u32 TakeDueCycles(f64 elapsed);
+    static constexpr f64 MAX_CATCHUP_SECONDS = 4.0 / TIMER_HZ;
+    // Instructions dropped that way since the last ROM load
+    const u64 GetDroppedCycles() const { return _droppedCycles; }
+    // Instructions in frames whole frames of emulated time, in either mode
+    const u64 GetCyclesForFrames(u64 frames) const { return _clockMode == ClockMode::CyclesPerFrame ? frames * _cyclesPerFrame : frames * _instructionsPerSecond / TIMER_HZ; }
+    // Not owned, receives the tone state every timer tick. Null for silence.
+    void SetAudioSink(AudioSink* sink) { _audio = sink; }
+
+    // Idle loops are accounted for without being run, see CPU::SkipIdleLoop. On by default.
+    void SetIdleSkip(bool skip) { _idleSkip = skip; }
+    bool IsIdleSkipEnabled() const { return _idleSkip; }
+    // Of GetTotalCycles(), the ones skipped since the last ROM load, halted ones included
+    const u64 GetIdleCycles() const { return _idleCycles; }
+
+    const u64 GetTotalCycles() const { return _totalCycles; }
+    const u64 GetTimerTicks() const { return _timerTicks; }
+    const f64 GetEmulatedSeconds() const { return (f64)_timerTicks / TIMER_HZ; }
+
 private:
     void Init();
+    void Boot();
+    // Returns the instructions executed, fewer than count if FX0A halts
+    u32 Execute(u32 count);
     void SingleCycle();
+    void TickTimers();
+    // Instructions in the frame that's running, see TIMER_HZ
+    u32 GetFrameLength() const;
 
 private:
     CPU* _cpu = nullptr;
+    AudioSink* _audio = nullptr;
+    InputScript* _recording = nullptr;
     std::vector<char> _currentRom{};
     size_t _currRomSize = 0;
+    Chip8Snapshot _boot{}; // Right after the last ROM load
+
+    bool _seeded = false;
+    u32 _seed = 0;
 
     bool _paused = true;
     bool _doStep = false;
     int  _cyclesPerFrame = 10;
+
+    ClockMode _clockMode = ClockMode::CyclesPerFrame;
+    u32 _instructionsPerSecond = 600;
+    f64 _cyclesDue = 0.0; // Fractions carried over between TakeDueCycles calls
+    u64 _droppedCycles = 0;
+
+    u32 _cyclesSinceTick = 0;
+    u64 _totalCycles = 0;
+    u64 _timerTicks = 0;
+
+    bool _idleSkip = true;
+    u64 _idleCycles = 0;
 };
\ No newline at end of file
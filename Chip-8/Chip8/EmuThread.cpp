@@ -0,0 +1,370 @@
+#include "EmuThread.h"
+
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <utility>
+
+EmuThread::EmuThread(Chip8* chip, std::function<void()> onPublish)
+    : _chip(chip), _onPublish(std::move(onPublish))
+{
+    // The frontend always has a frame to look at, even before the thread gets going
+    Publish();
+    Update();
+
+    _running = true;
+    _thread = std::thread(&EmuThread::ThreadMain, this);
+}
+
+EmuThread::~EmuThread()
+{
+    _running = false;
+    {
+        std::lock_guard lock(_wakeMutex);
+    }
+    _wake.notify_one();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+bool EmuThread::Update()
+{
+    if (!_frames.Update())
+        return false;
+
+    const EmuFrame& frame = GetFrame();
+    _view.Bind(&frame.state, frame.dispatchMode, frame.staticProgram);
+    return true;
+}
+
+void EmuThread::Send(CommandType type, i32 value, std::string path)
+{
+    // Only fills up if the emulation thread has stalled for hundreds of commands
+    if (!_commands.TryPush({ type, value, std::move(path) }))
+    {
+        _droppedCommands++;
+        return;
+    }
+
+    // Pairs with the fence in WaitForCommand: either this sees _sleeping, or the
+    // emulation thread sees the command before it sleeps. Running, it's never locked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!_sleeping.load(std::memory_order_relaxed))
+        return;
+
+    // Taking the lock orders the push before a sleeping thread's check of the queue, so the wake can't be missed
+    {
+        std::lock_guard lock(_wakeMutex);
+    }
+    _wake.notify_one();
+}
+
+void EmuThread::ThreadMain()
+{
+    const auto framePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<f64>(1.0 / Chip8::TIMER_HZ));
+
+    auto next = Clock::now();
+    auto last = next;
+    _rateStart = next;
+    while (_running.load(std::memory_order_relaxed))
+    {
+        ProcessCommands();
+
+        // The instructions per second clock goes by the real time between frames, not framePeriod
+        const auto start = Clock::now();
+        const f64 elapsed = std::chrono::duration<f64>(start - last).count();
+        last = start;
+
+        if (!_rewound)
+        {
+            if (_turbo && !_chip->IsPaused())
+                RunTurbo(next + framePeriod);
+            else
+                RunFrame(elapsed);
+            Record();
+        }
+        _rewound = false;
+
+        _emulationSeconds += std::chrono::duration<f64>(Clock::now() - start).count();
+        _rateFrames++;
+
+        const bool idle = IsIdle();
+        MeasureRate(idle);
+        Publish();
+
+        if (idle)
+        {
+            // Emulated time stands still meanwhile, nothing could have observed it passing
+            WaitForCommand();
+            next = last = _rateStart = Clock::now();
+            _rateFrames = 0;
+            _emulationSeconds = 0.0;
+            continue;
+        }
+
+        // Fall behind by more than a few frames and we just carry on from now, rather than racing to catch up
+        next += framePeriod;
+        const auto now = Clock::now();
+        if (now - next > framePeriod * 4)
+            next = now;
+
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void EmuThread::ProcessCommands()
+{
+    Command command;
+    while (_commands.TryPop(command))
+    {
+        switch (command.type)
+        {
+        case CommandType::LoadROM:
+            _chip->SetRecording(nullptr);
+            _replaying = false;
+            _chip->LoadROM(command.path);
+            _rewind.Clear();
+            break;
+        case CommandType::Reset:
+            _chip->Reset();
+            _rewind.Clear();
+            _recording.Truncate(0);
+            _player.Seek(0);
+            break;
+        case CommandType::SetPaused: _chip->SetPaused(command.value != 0); break;
+        case CommandType::TogglePaused: _chip->TogglePaused(); break;
+        case CommandType::Step:
+            // Through the player, so recorded keys still land on their cycles
+            if (_replaying)
+                _player.Run(*_chip, 1);
+            else
+                _chip->StepOnce();
+            break;
+        case CommandType::SetCyclesPerFrame: _chip->SetCyclesPerFrame(command.value); break;
+        case CommandType::SetClockMode: _chip->SetClockMode((ClockMode)command.value); break;
+        case CommandType::SetInstructionsPerSecond: _chip->SetInstructionsPerSecond((u32)command.value); break;
+        case CommandType::SetDispatchMode: _chip->GetCPU()->SetDispatchMode((DispatchMode)command.value); break;
+        case CommandType::SetIdleSkip: _chip->SetIdleSkip(command.value != 0); break;
+        case CommandType::SetTurbo: _turbo = command.value != 0; break;
+        case CommandType::KeyDown: _chip->KeyDown((u8)command.value); break;
+        case CommandType::KeyUp: _chip->KeyUp((u8)command.value); break;
+        case CommandType::StepBack: RewindFrames(command.value); break;
+        case CommandType::SetRewindCapacity: _rewind.SetCapacity((size_t)command.value << 20); break;
+        case CommandType::StartRecording: BeginRecording(); break;
+        case CommandType::StopRecording: EndRecording(command.path); break;
+        case CommandType::Replay: BeginReplay(command.path); break;
+        }
+    }
+}
+
+void EmuThread::RunFrame(f64 elapsed)
+{
+    if (!_replaying)
+    {
+        _chip->Cycle(elapsed);
+        return;
+    }
+
+    if (!_chip->IsPaused())
+    {
+        const bool timed = _chip->GetClockMode() == ClockMode::InstructionsPerSecond;
+        _player.Run(*_chip, timed ? _chip->TakeDueCycles(elapsed) : _chip->GetCyclesPerFrame());
+    }
+
+    // Past the last event it's just a normal run again
+    if (_player.IsDone())
+        _replaying = false;
+}
+
+bool EmuThread::IsIdle() const
+{
+    if (_chip->IsPaused())
+        return true;
+    if (_replaying)
+        return false; // The script may have a key coming
+
+    // The timers still count down while FX0A waits, and the tone plays until they do
+    const CPU* cpu = _chip->GetCPU();
+    return _chip->IsWaitingForKey() && cpu->GetDelayTimer() == 0 && cpu->GetSoundTimer() == 0;
+}
+
+void EmuThread::WaitForCommand()
+{
+    std::unique_lock lock(_wakeMutex);
+    _sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    _wake.wait(lock, [this] { return _commands.Size() != 0 || !_running.load(std::memory_order_relaxed); });
+    _sleeping.store(false, std::memory_order_relaxed);
+}
+
+void EmuThread::RunTurbo(Clock::time_point until)
+{
+    // Slices sized to take about TURBO_SLICE_SECONDS, so the clock is read rarely and the
+    // frame still goes out close to on time
+    do
+    {
+        const auto start = Clock::now();
+        if (_replaying)
+        {
+            _player.Run(*_chip, _turboSlice);
+            if (_player.IsDone())
+                _replaying = false;
+        }
+        else
+            _chip->RunCycles(_turboSlice);
+
+        const f64 seconds = std::chrono::duration<f64>(Clock::now() - start).count();
+        if (seconds < TURBO_SLICE_SECONDS / 2 && _turboSlice < MAX_TURBO_SLICE)
+            _turboSlice *= 2;
+        else if (seconds > TURBO_SLICE_SECONDS * 2 && _turboSlice > MIN_TURBO_SLICE)
+            _turboSlice /= 2;
+    } while (Clock::now() < until && !IsIdle());
+}
+
+void EmuThread::MeasureRate(bool idle)
+{
+    // Nothing will run until the next command, so don't leave the last rate showing meanwhile
+    if (idle)
+    {
+        _achievedIps = 0.0;
+        _emulationMs = 0.0;
+        return;
+    }
+
+    const auto now = Clock::now();
+    const u64 cycles = _chip->GetTotalCycles();
+
+    // Rewinds, resets and loads move the count backwards, start a new window from there
+    if (cycles < _rateCycles)
+    {
+        _rateStart = now;
+        _rateCycles = cycles;
+        _rateFrames = 0;
+        _emulationSeconds = 0.0;
+        return;
+    }
+
+    const f64 seconds = std::chrono::duration<f64>(now - _rateStart).count();
+    if (seconds < RATE_WINDOW_SECONDS)
+        return;
+
+    _achievedIps = (cycles - _rateCycles) / seconds;
+    _emulationMs = _rateFrames ? _emulationSeconds * 1000.0 / _rateFrames : 0.0;
+    _rateStart = now;
+    _rateCycles = cycles;
+    _rateFrames = 0;
+    _emulationSeconds = 0.0;
+}
+
+void EmuThread::RewindFrames(i32 frames)
+{
+    bool stepped = false;
+    for (i32 i = 0; i < frames && _rewind.StepBack(_snapshot); i++)
+        stepped = true;
+
+    // Only the frame we land on needs loading
+    if (stepped)
+        _chip->LoadState(_snapshot);
+
+    // Input from the frames gone back over never happened
+    _recordedCycles = _chip->GetTotalCycles();
+    _recording.Truncate(_recordedCycles);
+    _player.Seek(_recordedCycles);
+    _rewound = true;
+}
+
+void EmuThread::Record()
+{
+    // Paused frames that didn't run anything would only be duplicates
+    if (_rewind.GetFrameCount() && _chip->GetTotalCycles() == _recordedCycles)
+        return;
+
+    _chip->SaveState(_snapshot);
+    _rewind.Push(_snapshot);
+    _recordedCycles = _chip->GetTotalCycles();
+}
+
+void EmuThread::BeginRecording()
+{
+    // From boot with a known seed, so the script alone is enough to replay it
+    if (!_chip->IsSeeded())
+        _chip->SetSeed(std::random_device{}());
+    _chip->Reset();
+    _rewind.Clear();
+    _replaying = false;
+
+    _recording.Clear();
+    _recording.SetSeed(_chip->GetSeed());
+    if (_chip->GetClockMode() == ClockMode::InstructionsPerSecond)
+        _recording.SetInstructionsPerSecond(_chip->GetInstructionsPerSecond());
+    else
+        _recording.SetCyclesPerFrame(_chip->GetCyclesPerFrame());
+    _chip->SetRecording(&_recording);
+}
+
+void EmuThread::EndRecording(const std::string& path)
+{
+    if (!_chip->IsRecording())
+        return;
+
+    _chip->SetRecording(nullptr);
+    if (!_recording.Save(path))
+        printf("Failed to save input recording to %s\n", path.c_str());
+}
+
+void EmuThread::BeginReplay(const std::string& path)
+{
+    if (!_replay.Load(path))
+    {
+        printf("Failed to load input script %s\n", path.c_str());
+        return;
+    }
+
+    _chip->SetRecording(nullptr);
+    _player.Begin(*_chip);
+    _rewind.Clear();
+    _replaying = true;
+    _chip->SetPaused(false);
+}
+
+void EmuThread::Publish()
+{
+    CPU* cpu = _chip->GetCPU();
+
+    _published++;
+    for (u64 rows = cpu->ConsumeDirtyRows(); rows; rows &= rows - 1)
+        _rowChanged[std::countr_zero(rows)] = _published;
+
+    EmuFrame& frame = _frames.Back();
+    frame.state = cpu->GetState();
+    frame.index = _published;
+    frame.rowChanged = _rowChanged;
+    frame.totalCycles = _chip->GetTotalCycles();
+    frame.idleCycles = _chip->GetIdleCycles();
+    frame.idleSkip = _chip->IsIdleSkipEnabled();
+    frame.emulatedSeconds = _chip->GetEmulatedSeconds();
+    frame.romSize = _chip->GetROMSize();
+    frame.cyclesPerFrame = _chip->GetCyclesPerFrame();
+    frame.clockMode = _chip->GetClockMode();
+    frame.instructionsPerSecond = _chip->GetInstructionsPerSecond();
+    frame.achievedIps = _achievedIps;
+    frame.emulationMs = _emulationMs;
+    frame.turbo = _turbo;
+    frame.droppedCycles = _chip->GetDroppedCycles();
+    frame.dispatchMode = cpu->GetDispatchMode();
+    frame.staticProgram = cpu->GetStaticProgram();
+    frame.paused = _chip->IsPaused();
+    frame.recording = _chip->IsRecording();
+    frame.replaying = _replaying;
+    frame.rewindFrames = _rewind.GetFrameCount();
+    frame.rewindUsedBytes = _rewind.GetUsedBytes();
+    frame.rewindCapacity = _rewind.GetCapacity();
+    frame.rewindRatio = _rewind.GetCompressionRatio();
+
+    _frames.Publish();
+
+    if (_onPublish)
+        _onPublish();
+}
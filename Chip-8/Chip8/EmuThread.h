@@ -0,0 +1,223 @@
+#pragma once
+
+#include "Types.h"
+#include "Chip8.h"
+#include "CPUView.h"
+#include "InputScript.h"
+#include "Rewind.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Everything the frontend sees of one emulated frame
+struct EmuFrame
+{
+    CPUState state;
+
+    u64 index = 0; // Publish count, starts at 1
+    std::array<u64, CPU::SCREEN_HEIGHT> rowChanged{}; // Index of the frame each row last changed in
+
+    u64 totalCycles = 0;
+    u64 idleCycles = 0;
+    bool idleSkip = true;
+    f64 emulatedSeconds = 0.0;
+    size_t romSize = 0;
+    i32 cyclesPerFrame = 0;
+    ClockMode clockMode = ClockMode::CyclesPerFrame;
+    u32 instructionsPerSecond = 0; // Target, in ClockMode::InstructionsPerSecond
+    f64 achievedIps = 0.0; // Measured over the last RATE_WINDOW_SECONDS, in either mode
+    f64 emulationMs = 0.0; // Wall time the emulation thread spent running per published frame, same window
+    bool turbo = false;
+    u64 droppedCycles = 0;
+    DispatchMode dispatchMode = DispatchMode::Cached;
+    const StaticProgram* staticProgram = nullptr;
+    bool paused = true;
+    bool recording = false;
+    bool replaying = false;
+
+    size_t rewindFrames = 0;
+    size_t rewindUsedBytes = 0;
+    size_t rewindCapacity = 0;
+    f64 rewindRatio = 0.0;
+
+    // Rows that changed in any frame after index, bit y for row y
+    u64 RowsChangedSince(u64 since) const
+    {
+        u64 rows = 0;
+        for (i32 y = 0; y < CPU::SCREEN_HEIGHT; y++)
+            rows |= (u64)(rowChanged[y] > since) << y;
+        return rows;
+    }
+};
+
+// Runs a Chip8 on its own thread at 60 frames per second. Completed frames are published
+// through a triple buffer and everything else arrives as commands over an SPSC queue,
+// so neither side ever waits on the other. When nothing can happen until the next
+// command, paused or halted on FX0A with the timers run down, the thread sleeps until one arrives.
+// Send only takes the wake lock while it sleeps.
+//
+// All other methods are for the frontend thread. They mirror Chip8's, with getters
+// answering from the newest frame picked up by Update().
+class EmuThread
+{
+public:
+    // onPublish, if set, is called after every published frame, from the emulation thread once it runs
+    EmuThread(Chip8* chip, std::function<void()> onPublish = {});
+    ~EmuThread();
+
+    // Picks up the newest published frame, returns false if there was none
+    bool Update();
+    const EmuFrame& GetFrame() const { return _frames.Front(); }
+
+    const CPUView* GetCPU() const { return &_view; }
+
+    const size_t GetROMSize() const { return GetFrame().romSize; }
+    bool IsPaused() const { return GetFrame().paused; }
+    int  GetCyclesPerFrame() const { return GetFrame().cyclesPerFrame; }
+    const u64 GetTotalCycles() const { return GetFrame().totalCycles; }
+    const f64 GetEmulatedSeconds() const { return GetFrame().emulatedSeconds; }
+
+    void LoadROM(std::string_view filePath) { Send(CommandType::LoadROM, 0, std::string(filePath)); }
+    void Reset() { Send(CommandType::Reset); }
+
+    void SetPaused(bool p) { Send(CommandType::SetPaused, p); }
+    void TogglePaused() { Send(CommandType::TogglePaused); }
+    void StepOnce() { Send(CommandType::Step); }
+    void SetCyclesPerFrame(i32 n) { Send(CommandType::SetCyclesPerFrame, n); }
+    void SetClockMode(ClockMode mode) { Send(CommandType::SetClockMode, (i32)mode); }
+    ClockMode GetClockMode() const { return GetFrame().clockMode; }
+    void SetInstructionsPerSecond(u32 ips) { Send(CommandType::SetInstructionsPerSecond, (i32)ips); }
+    const u32 GetInstructionsPerSecond() const { return GetFrame().instructionsPerSecond; }
+    const f64 GetAchievedIps() const { return GetFrame().achievedIps; }
+
+    // Runs as fast as the host allows instead of at the clock's rate, still publishing at 60 Hz
+    void SetTurbo(bool turbo) { Send(CommandType::SetTurbo, turbo); }
+    bool IsTurbo() const { return GetFrame().turbo; }
+    void SetDispatchMode(DispatchMode mode) { Send(CommandType::SetDispatchMode, (i32)mode); }
+    void SetIdleSkip(bool skip) { Send(CommandType::SetIdleSkip, skip); }
+    bool IsIdleSkipEnabled() const { return GetFrame().idleSkip; }
+    const u64 GetIdleCycles() const { return GetFrame().idleCycles; }
+
+    void KeyDown(u8 hex) { Send(CommandType::KeyDown, hex); }
+    void KeyUp(u8 hex) { Send(CommandType::KeyUp, hex); }
+
+    // Goes back frames frames, the emulation holds still for the tick it happens in
+    void StepBack(i32 frames = 1) { Send(CommandType::StepBack, frames); }
+    // Clears the rewind history
+    void SetRewindCapacity(size_t bytes) { Send(CommandType::SetRewindCapacity, (i32)(bytes >> 20)); }
+    const size_t GetRewindFrames() const { return GetFrame().rewindFrames; }
+
+    // Resets into deterministic mode and records key events until stopped, then saves them to path
+    void StartRecording() { Send(CommandType::StartRecording); }
+    void StopRecording(std::string_view path) { Send(CommandType::StopRecording, 0, std::string(path)); }
+    bool IsRecording() const { return GetFrame().recording; }
+    // Plays an input script from the start of the ROM, see InputPlayer::Begin
+    void Replay(std::string_view path) { Send(CommandType::Replay, 0, std::string(path)); }
+    bool IsReplaying() const { return GetFrame().replaying; }
+
+    // Commands lost to a full queue, a dropped KeyUp leaves that key held down
+    const u64 GetDroppedCommands() const { return _droppedCommands; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class CommandType : u8
+    {
+        LoadROM,
+        Reset,
+        SetPaused,
+        TogglePaused,
+        Step,
+        SetCyclesPerFrame,
+        SetClockMode,
+        SetInstructionsPerSecond,
+        SetDispatchMode,
+        SetIdleSkip,
+        SetTurbo,
+        KeyDown,
+        KeyUp,
+        StepBack,
+        SetRewindCapacity, // value in MiB
+        StartRecording,
+        StopRecording,
+        Replay
+    };
+
+    struct Command
+    {
+        CommandType type = CommandType::Reset;
+        i32 value = 0;
+        std::string path;
+    };
+
+    void Send(CommandType type, i32 value = 0, std::string path = {});
+
+    // Emulation thread
+    void ThreadMain();
+    void ProcessCommands();
+    void RunFrame(f64 elapsed);
+    void RunTurbo(Clock::time_point until);
+    void MeasureRate(bool idle);
+    bool IsIdle() const;
+    void WaitForCommand();
+    void RewindFrames(i32 frames);
+    void Record();
+    void BeginRecording();
+    void EndRecording(const std::string& path);
+    void BeginReplay(const std::string& path);
+    void Publish();
+
+private:
+    static constexpr f64 RATE_WINDOW_SECONDS = 0.5;
+    static constexpr f64 TURBO_SLICE_SECONDS = 0.001;
+    static constexpr u32 MIN_TURBO_SLICE = 256;
+    static constexpr u32 MAX_TURBO_SLICE = 1u << 24;
+
+    Chip8* _chip = nullptr; // Only touched by the emulation thread once it runs
+    std::function<void()> _onPublish;
+
+    SpscQueue<Command, 256> _commands;
+    TripleBuffer<EmuFrame> _frames;
+
+    // Emulation thread
+    u64 _published = 0;
+    std::array<u64, CPU::SCREEN_HEIGHT> _rowChanged{};
+
+    Rewind _rewind;
+    Chip8Snapshot _snapshot{};
+    u64 _recordedCycles = 0;
+    bool _rewound = false; // Stepped back this tick, so don't run
+
+    InputScript _recording;
+    InputScript _replay;
+    InputPlayer _player{ _replay };
+    bool _replaying = false;
+
+    bool _turbo = false;
+    u32 _turboSlice = MIN_TURBO_SLICE; // Instructions, adapted to take TURBO_SLICE_SECONDS
+
+    Clock::time_point _rateStart{};
+    u64 _rateCycles = 0;
+    u32 _rateFrames = 0;
+    f64 _emulationSeconds = 0.0; // Running frames, since _rateStart
+    f64 _achievedIps = 0.0;
+    f64 _emulationMs = 0.0;
+
+    // Frontend thread
+    CPUView _view;
+    u64 _droppedCommands = 0;
+
+    std::atomic<bool> _running{ false };
+    std::atomic<bool> _sleeping{ false }; // In WaitForCommand, so Send has to wake it
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    std::thread _thread;
+};
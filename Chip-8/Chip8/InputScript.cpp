@@ -0,0 +1,190 @@
+#include "InputScript.h"
+
+#include "Chip8.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+bool InputScript::Load(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false; // Fails
+
+    std::stringstream text;
+    text << file.rdbuf();
+    return Parse(text.str());
+}
+
+bool InputScript::Parse(std::string_view text)
+{
+    Clear();
+
+    while (!text.empty())
+    {
+        const size_t end = std::min(text.find('\n'), text.size());
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos || line[first] == '#')
+            continue;
+        line.remove_prefix(first);
+
+        if (line.starts_with("seed") || line.starts_with("cpf") || line.starts_with("ips"))
+        {
+            const char setting = line[0];
+            line.remove_prefix(setting == 's' ? 4 : 3);
+            line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+
+            u32 value = 0;
+            auto [afterValue, valueError] = std::from_chars(line.data(), line.data() + line.size(), value);
+            if (valueError != std::errc())
+                return false; // Fails
+
+            if (setting == 's')
+                SetSeed(value);
+            else if (setting == 'c')
+                SetCyclesPerFrame((i32)std::max(1u, value));
+            else
+                SetInstructionsPerSecond(std::max(1u, value));
+            continue;
+        }
+
+        InputEvent event;
+        u32 key = 0;
+
+        const char* cursor = line.data();
+        const char* last = line.data() + line.size();
+
+        auto [afterCycle, cycleError] = std::from_chars(cursor, last, event.cycle);
+        if (cycleError != std::errc())
+            return false; // Fails
+        cursor = afterCycle;
+        while (cursor < last && (*cursor == ' ' || *cursor == '\t'))
+            cursor++;
+
+        auto [afterKey, keyError] = std::from_chars(cursor, last, key, 16);
+        if (keyError != std::errc() || key > 0xF)
+            return false; // Fails
+        cursor = afterKey;
+        while (cursor < last && (*cursor == ' ' || *cursor == '\t'))
+            cursor++;
+
+        if (cursor == last || (*cursor != 'd' && *cursor != 'u'))
+            return false; // Fails
+
+        event.key = (u8)key;
+        event.down = *cursor == 'd';
+        Add(event);
+    }
+
+    return true;
+}
+
+bool InputScript::Save(const std::filesystem::path& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+        return false; // Fails
+
+    file << ToString();
+    return (bool)file;
+}
+
+std::string InputScript::ToString() const
+{
+    std::string text = "# <cycle> <key> <d|u>\n";
+    if (_hasSeed)
+        text += "seed " + std::to_string(_seed) + "\n";
+    if (_cyclesPerFrame)
+        text += "cpf " + std::to_string(_cyclesPerFrame) + "\n";
+    if (_instructionsPerSecond)
+        text += "ips " + std::to_string(_instructionsPerSecond) + "\n";
+
+    char line[48];
+    for (const InputEvent& event : _events)
+    {
+        snprintf(line, sizeof(line), "%llu %X %c\n", (unsigned long long)event.cycle, event.key, event.down ? 'd' : 'u');
+        text += line;
+    }
+    return text;
+}
+
+void InputScript::Clear()
+{
+    _events.clear();
+    _hasSeed = false;
+    _seed = 0;
+    _cyclesPerFrame = 0;
+    _instructionsPerSecond = 0;
+}
+
+void InputScript::Truncate(u64 cycle)
+{
+    const auto it = std::lower_bound(_events.begin(), _events.end(), cycle,
+        [](const InputEvent& event, u64 c) { return event.cycle < c; });
+    _events.erase(it, _events.end());
+}
+
+void InputScript::Add(const InputEvent& event)
+{
+    // Events at the same cycle keep the order they were added in
+    const auto it = std::upper_bound(_events.begin(), _events.end(), event,
+        [](const InputEvent& a, const InputEvent& b) { return a.cycle < b.cycle; });
+    _events.insert(it, event);
+}
+
+void InputPlayer::Begin(Chip8& chip)
+{
+    if (_script->HasSeed())
+        chip.SetSeed(_script->GetSeed());
+    if (_script->GetCyclesPerFrame())
+    {
+        chip.SetCyclesPerFrame(_script->GetCyclesPerFrame());
+        chip.SetClockMode(ClockMode::CyclesPerFrame);
+    }
+    if (_script->GetInstructionsPerSecond())
+    {
+        chip.SetInstructionsPerSecond(_script->GetInstructionsPerSecond());
+        chip.SetClockMode(ClockMode::InstructionsPerSecond);
+    }
+
+    chip.Reset();
+    _next = 0;
+}
+
+void InputPlayer::Seek(u64 cycle)
+{
+    const std::vector<InputEvent>& events = _script->GetEvents();
+    _next = std::lower_bound(events.begin(), events.end(), cycle,
+        [](const InputEvent& event, u64 c) { return event.cycle < c; }) - events.begin();
+}
+
+void InputPlayer::Run(Chip8& chip, u64 cycles)
+{
+    const std::vector<InputEvent>& events = _script->GetEvents();
+    const u64 end = chip.GetTotalCycles() + cycles;
+
+    while (true)
+    {
+        const u64 now = chip.GetTotalCycles();
+        for (; _next < events.size() && events[_next].cycle <= now; _next++)
+        {
+            if (events[_next].down)
+                chip.KeyDown(events[_next].key);
+            else
+                chip.KeyUp(events[_next].key);
+        }
+
+        if (now >= end)
+            break;
+
+        // Run up to the next event, in pieces RunCycles can take
+        const u64 until = _next < events.size() ? std::min(end, events[_next].cycle) : end;
+        chip.RunCycles((u32)std::min<u64>(until - now, 1u << 30));
+    }
+}
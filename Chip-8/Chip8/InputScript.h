@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Types.h"
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Chip8;
+
+struct InputEvent
+{
+    u64 cycle = 0; // Chip8::GetTotalCycles() the event happens at
+    u8 key = 0;
+    bool down = false;
+};
+
+// Key presses keyed by emulated cycle, so a run replays identically at any speed.
+// Text format, one event per line: <cycle> <key in hex> <d|u>
+// Optional settings the run was recorded with: seed <n>, and cpf <n> or ips <n>, each on its own line.
+// Blank lines and lines starting with # are ignored.
+class InputScript
+{
+public:
+    bool Load(const std::filesystem::path& path);
+    bool Parse(std::string_view text);
+    bool Save(const std::filesystem::path& path) const;
+    std::string ToString() const;
+
+    void Clear();
+    void Add(const InputEvent& event);
+    // Drops the events at cycle and later, for when the run they came from was rewound
+    void Truncate(u64 cycle);
+    const std::vector<InputEvent>& GetEvents() const { return _events; }
+
+    void SetSeed(u32 seed) { _hasSeed = true; _seed = seed; }
+    bool HasSeed() const { return _hasSeed; }
+    const u32 GetSeed() const { return _seed; }
+
+    // 0 when the script doesn't say
+    void SetCyclesPerFrame(i32 n) { _cyclesPerFrame = n; }
+    const i32 GetCyclesPerFrame() const { return _cyclesPerFrame; }
+    // Recorded in ClockMode::InstructionsPerSecond, 0 when not
+    void SetInstructionsPerSecond(u32 ips) { _instructionsPerSecond = ips; }
+    const u32 GetInstructionsPerSecond() const { return _instructionsPerSecond; }
+
+private:
+    std::vector<InputEvent> _events; // Sorted by cycle
+
+    bool _hasSeed = false;
+    u32 _seed = 0;
+    i32 _cyclesPerFrame = 0;
+    u32 _instructionsPerSecond = 0;
+};
+
+// Runs a Chip8 while applying a script's events at their cycles
+class InputPlayer
+{
+public:
+    InputPlayer(const InputScript& script) : _script(&script) {}
+
+    // Applies the script's seed and clock and resets the chip, for replaying
+    // a recording from the start exactly
+    void Begin(Chip8& chip);
+    // Continues from the chip's current cycle, after it was moved by a rewind or a state load
+    void Seek(u64 cycle);
+
+    void Run(Chip8& chip, u64 cycles);
+    bool IsDone() const { return _next >= _script->GetEvents().size(); }
+
+private:
+    const InputScript* _script;
+    size_t _next = 0;
+};
@@ -0,0 +1,407 @@
+#include "Jit.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_X64 1
+#else
+#define CHIP8_JIT_X64 0
+#endif
+
+namespace
+{
+    // The state pointer arrives in the first argument register and stays there.
+#if defined(_WIN32)
+    constexpr u8 BASE = 1; // rcx
+#else
+    constexpr u8 BASE = 7; // rdi
+#endif
+    constexpr u8 AL = 0;
+    constexpr u8 DL = 2;
+    constexpr u8 SIB = 4;
+
+    constexpr u32 V = offsetof(CPUState, _registers);
+    constexpr u32 VF = V + 0xF;
+    constexpr u32 I = offsetof(CPUState, _index);
+    constexpr u32 PC = offsetof(CPUState, _pc);
+    constexpr u32 OPCODE = offsetof(CPUState, _opcode);
+    constexpr u32 STACK = offsetof(CPUState, _stack);
+    constexpr u32 SP = offsetof(CPUState, _sp);
+    constexpr u32 DT = offsetof(CPUState, _delayTimer);
+    constexpr u32 ST = offsetof(CPUState, _soundTimer);
+
+    // Worst case is 8XY5/8XY7 at 39 bytes, plus the epilogue
+    constexpr size_t MAX_INSTRUCTION_SIZE = 48;
+    constexpr size_t EPILOGUE_SIZE = 32;
+
+    class Emitter
+    {
+    public:
+        explicit Emitter(u8* code) : _code(code) {}
+
+        size_t Size() const { return _size; }
+
+        void Byte(u8 b) { _code[_size++] = b; }
+        void Word(u16 w) { Byte(w & 0xFF); Byte(w >> 8); }
+        void Dword(u32 d) { Word(d & 0xFFFF); Word(d >> 16); }
+
+        // [state + disp32] operand, reg is a register or an opcode extension
+        void Mem(u8 reg, u32 disp) { Byte(0x80 | (reg << 3) | BASE); Dword(disp); }
+
+        // [state + rax * 2 + disp32] operand, for indexing the stack
+        void StackSlot(u8 reg) { Byte(0x80 | (reg << 3) | SIB); Byte(0x40 | BASE); Dword(STACK); }
+
+        void Load8(u8 reg, u32 disp) { Byte(0x8A); Mem(reg, disp); }
+        void Store8(u32 disp, u8 reg) { Byte(0x88); Mem(reg, disp); }
+        void StorePc(u16 pc) { Byte(0x66); Byte(0xC7); Mem(0, PC); Word(pc); } // mov word [pc], pc
+
+        // eax = sp & 0xF, the interpreter doesn't bound SP but native code shouldn't leave the stack
+        void LoadStackIndex() { Byte(0x0F); Byte(0xB7); Mem(AL, SP); Byte(0x83); Byte(0xE0); Byte(0x0F); }
+
+    private:
+        u8* _code;
+        size_t _size = 0;
+    };
+
+    void EmitInstruction(Emitter& e, u16 opcode, u16 fontAddress)
+    {
+        const u16 nnn = opcode & 0x0FFF;
+        const u8 nn = opcode & 0x00FF;
+        const u8 x = (opcode & 0x0F00) >> 8;
+        const u8 y = (opcode & 0x00F0) >> 4;
+
+        switch (opcode & 0xF000)
+        {
+        case 0x0000: break; // 0NNN, NOP
+        case 0x6000: e.Byte(0xC6); e.Mem(0, V + x); e.Byte(nn); break; // mov byte [Vx], nn
+        case 0x7000: e.Byte(0x80); e.Mem(0, V + x); e.Byte(nn); break; // add byte [Vx], nn
+        case 0x8000:
+        {
+            switch (opcode & 0x000F)
+            {
+            case 0x0: e.Load8(AL, V + y); e.Store8(V + x, AL); break;
+            case 0x1: e.Load8(AL, V + y); e.Byte(0x08); e.Mem(AL, V + x); break; // or [Vx], al
+            case 0x2: e.Load8(AL, V + y); e.Byte(0x20); e.Mem(AL, V + x); break; // and [Vx], al
+            case 0x3: e.Load8(AL, V + y); e.Byte(0x30); e.Mem(AL, V + x); break; // xor [Vx], al
+            case 0x4:
+                e.Load8(AL, V + x);
+                e.Byte(0x02); e.Mem(AL, V + y); // add al, [Vy]
+                e.Byte(0x0F); e.Byte(0x92); e.Byte(0xC2); // setc dl
+                e.Store8(VF, DL);
+                e.Store8(V + x, AL);
+                break;
+            case 0x5:
+                // The interpreter writes VF first and then re-reads Vx and Vy, which matters when either is VF
+                e.Load8(AL, V + x);
+                e.Byte(0x3A); e.Mem(AL, V + y); // cmp al, [Vy]
+                e.Byte(0x0F); e.Byte(0x97); e.Byte(0xC2); // seta dl
+                e.Store8(VF, DL);
+                e.Load8(AL, V + x);
+                e.Byte(0x2A); e.Mem(AL, V + y); // sub al, [Vy]
+                e.Store8(V + x, AL);
+                break;
+            case 0x6:
+                e.Load8(AL, V + x);
+                e.Byte(0x24); e.Byte(0x01); // and al, 1
+                e.Store8(VF, AL);
+                e.Byte(0xD0); e.Mem(5, V + x); // shr byte [Vx], 1
+                break;
+            case 0x7:
+                e.Load8(AL, V + y);
+                e.Byte(0x3A); e.Mem(AL, V + x); // cmp al, [Vx]
+                e.Byte(0x0F); e.Byte(0x97); e.Byte(0xC2); // seta dl
+                e.Store8(VF, DL);
+                e.Load8(AL, V + y);
+                e.Byte(0x2A); e.Mem(AL, V + x); // sub al, [Vx]
+                e.Store8(V + x, AL);
+                break;
+            case 0xE:
+                e.Load8(AL, V + x);
+                e.Byte(0xC0); e.Byte(0xE8); e.Byte(0x07); // shr al, 7
+                e.Store8(VF, AL);
+                e.Byte(0xD0); e.Mem(4, V + x); // shl byte [Vx], 1
+                break;
+            }
+        } break;
+        case 0xA000: e.Byte(0x66); e.Byte(0xC7); e.Mem(0, I); e.Word(nnn); break; // mov word [I], nnn
+        case 0xF000:
+        {
+            if (nn == 0x07 || nn == 0x15 || nn == 0x18)
+            {
+                const u32 to = nn == 0x07 ? V + x : nn == 0x15 ? DT : ST;
+                e.Load8(AL, nn == 0x07 ? DT : V + x);
+                e.Store8(to, AL);
+                break;
+            }
+
+            e.Byte(0x0F); e.Byte(0xB6); e.Mem(AL, V + x); // movzx eax, byte [Vx]
+
+            if (nn == 0x29)
+            {
+                e.Byte(0x8D); e.Byte(0x84); e.Byte(0x80); e.Dword(fontAddress); // lea eax, [rax + rax * 4 + font]
+                e.Byte(0x66); e.Byte(0x89); e.Mem(AL, I); // mov word [I], ax
+            }
+            else
+            {
+                e.Byte(0x66); e.Byte(0x01); e.Mem(AL, I); // add word [I], ax
+            }
+        } break;
+        }
+    }
+
+    // Branches end a translation by storing where execution continues. next is the
+    // address after the branch, and the skips store it before deciding to skip.
+    void EmitExit(Emitter& e, u16 opcode, u16 next)
+    {
+        const u16 nnn = opcode & 0x0FFF;
+        const u8 nn = opcode & 0x00FF;
+        const u8 x = (opcode & 0x0F00) >> 8;
+        const u8 y = (opcode & 0x00F0) >> 4;
+
+        // Jumps over the StorePc after it, which is 9 bytes
+        constexpr u8 JE = 0x74;
+        constexpr u8 JNE = 0x75;
+        auto skip = [&](u8 jumpUnlessSkip)
+            {
+                e.Byte(jumpUnlessSkip); e.Byte(9);
+                e.StorePc(next + 2);
+            };
+
+        switch (opcode & 0xF000)
+        {
+        case 0x0000: // 00EE
+            e.Byte(0x66); e.Byte(0xFF); e.Mem(1, SP); // dec word [sp]
+            e.LoadStackIndex();
+            e.Byte(0x0F); e.Byte(0xB7); e.StackSlot(DL); // movzx edx, word [stack + rax * 2]
+            e.Byte(0x66); e.Byte(0x89); e.Mem(DL, PC); // mov word [pc], dx
+            break;
+        case 0x1000: e.StorePc(nnn); break;
+        case 0x2000:
+            e.LoadStackIndex();
+            e.Byte(0x66); e.Byte(0xC7); e.StackSlot(0); e.Word(next); // mov word [stack + rax * 2], next
+            e.Byte(0x66); e.Byte(0xFF); e.Mem(0, SP); // inc word [sp]
+            e.StorePc(nnn);
+            break;
+        case 0x3000:
+        case 0x4000:
+            e.StorePc(next);
+            e.Byte(0x80); e.Mem(7, V + x); e.Byte(nn); // cmp byte [Vx], nn
+            skip((opcode & 0xF000) == 0x3000 ? JNE : JE);
+            break;
+        case 0x5000:
+        case 0x9000:
+            e.StorePc(next);
+            e.Load8(AL, V + x);
+            e.Byte(0x3A); e.Mem(AL, V + y); // cmp al, [Vy]
+            skip((opcode & 0xF000) == 0x5000 ? JNE : JE);
+            break;
+        case 0xB000:
+            e.Byte(0x0F); e.Byte(0xB6); e.Mem(AL, V); // movzx eax, byte [V0]
+            e.Byte(0x05); e.Dword(nnn); // add eax, nnn
+            e.Byte(0x66); e.Byte(0x89); e.Mem(AL, PC); // mov word [pc], ax
+            break;
+        }
+    }
+}
+
+Jit::~Jit()
+{
+    if (!_arena)
+        return;
+
+#if defined(_WIN32)
+    VirtualFree(_arena, 0, MEM_RELEASE);
+#else
+    munmap(_arena, ARENA_SIZE);
+#endif
+}
+
+bool Jit::IsSupported()
+{
+    return CHIP8_JIT_X64;
+}
+
+void Jit::Invalidate(u16 addr, u16 length)
+{
+    // The instruction one byte before the write also covers the first written byte
+    const u32 first = addr ? addr - 1 : 0;
+    const u32 last = std::min<u32>(addr + length, (u32)_translatedCode.size());
+
+    for (u32 a = first; a < last; a++)
+    {
+        if (_translatedCode[a])
+        {
+            Flush();
+            return;
+        }
+    }
+}
+
+void Jit::Flush()
+{
+    _translations.fill({});
+    _translatedCode.reset();
+    _arenaUsed = 0;
+}
+
+bool Jit::CanCompile(u16 opcode)
+{
+    switch (opcode & 0xF000)
+    {
+    case 0x0000: return opcode != 0x00E0;
+    case 0x1000:
+    case 0x2000:
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x6000:
+    case 0x7000:
+    case 0x9000:
+    case 0xA000:
+    case 0xB000:
+        return true;
+    case 0x8000:
+    {
+        const u8 n = opcode & 0x000F;
+        return n <= 0x7 || n == 0xE;
+    }
+    case 0xF000:
+    {
+        const u8 nn = opcode & 0x00FF;
+        return nn == 0x07 || nn == 0x15 || nn == 0x18 || nn == 0x1E || nn == 0x29;
+    }
+    }
+
+    return false;
+}
+
+bool Jit::EndsTranslation(u16 opcode)
+{
+    switch (opcode & 0xF000)
+    {
+    case 0x0000: return opcode == 0x00EE;
+    case 0x1000:
+    case 0x2000:
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000:
+    case 0xB000:
+        return true;
+    }
+
+    return false;
+}
+
+void Jit::Compile(const CPUState& state, u16 addr, u16 fontAddress)
+{
+    Translation& translation = _translations[addr];
+    translation = {};
+    translation.compiled = true;
+
+    if (!CHIP8_JIT_X64 || !AllocateArena())
+        return;
+
+    if (ARENA_SIZE - _arenaUsed < MAX_BLOCK_LENGTH * MAX_INSTRUCTION_SIZE + EPILOGUE_SIZE)
+    {
+        Flush();
+        translation.compiled = true;
+    }
+
+    // Nothing to translate, the interpreter runs it
+    if (addr >= state._memory.size() - 1 || !CanCompile(state._memory[addr] << 8 | state._memory[addr + 1]))
+        return;
+
+    if (!Protect(false))
+        return; // Fails
+
+    u8* code = _arena + _arenaUsed;
+    Emitter e(code);
+
+    u16 pc = addr;
+    u16 lastOpcode = 0;
+    bool exited = false;
+    while (translation.length < MAX_BLOCK_LENGTH && pc < state._memory.size() - 1)
+    {
+        const u16 opcode = state._memory[pc] << 8 | state._memory[pc + 1];
+        if (!CanCompile(opcode))
+            break;
+
+        _translatedCode[pc] = true;
+        translation.length++;
+        lastOpcode = opcode;
+        pc += 2;
+
+        if (EndsTranslation(opcode))
+        {
+            EmitExit(e, opcode, pc);
+            exited = true;
+            break;
+        }
+
+        EmitInstruction(e, opcode, fontAddress);
+    }
+
+    e.Byte(0x66); e.Byte(0xC7); e.Mem(0, OPCODE); e.Word(lastOpcode); // mov word [opcode], last
+    if (!exited)
+        e.StorePc(pc);
+    e.Byte(0xC3); // ret
+
+    _arenaUsed += e.Size();
+
+    if (!Protect(true))
+    {
+        Flush();
+        translation.compiled = true;
+        return; // Fails
+    }
+
+    translation.fn = reinterpret_cast<BlockFn>(code);
+}
+
+bool Jit::AllocateArena()
+{
+    if (_arena)
+        return true;
+
+    // Writable for now, Protect flips it to executable once code is in
+#if defined(_WIN32)
+    void* mem = VirtualAlloc(nullptr, ARENA_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    _arena = static_cast<u8*>(mem);
+#else
+    void* mem = mmap(nullptr, ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    _arena = mem == MAP_FAILED ? nullptr : static_cast<u8*>(mem);
+#endif
+    _executable = false;
+
+    return _arena != nullptr;
+}
+
+bool Jit::Protect(bool executable)
+{
+    if (_executable == executable)
+        return true;
+
+#if defined(_WIN32)
+    DWORD old = 0;
+    if (!VirtualProtect(_arena, ARENA_SIZE, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old))
+        return false; // Fails
+    if (executable)
+        FlushInstructionCache(GetCurrentProcess(), _arena, ARENA_SIZE);
+#else
+    if (mprotect(_arena, ARENA_SIZE, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) != 0)
+        return false; // Fails
+#endif
+
+    _executable = executable;
+    return true;
+}
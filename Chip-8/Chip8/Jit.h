@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Types.h"
+#include "CPUState.h"
+
+#include <array>
+#include <bitset>
+
+// Recompiles basic blocks into x86-64 code. A translation runs the ALU and timer
+// instructions of a block and ends at its jump, call, return or skip, which stores the
+// next PC. Drawing, keys, random numbers and memory writes are left to the interpreter.
+//
+// The arena is never writable and executable at once: it is writable while a
+// translation is emitted and executable otherwise.
+class Jit
+{
+public:
+    using BlockFn = void (*)(CPUState* state);
+
+    struct Translation
+    {
+        BlockFn fn = nullptr; // nullptr if the instruction at this address can't be recompiled
+        u16 length = 0; // Instructions
+        bool compiled = false;
+    };
+
+    Jit() = default;
+    ~Jit();
+
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    static bool IsSupported();
+
+    const Translation& Lookup(const CPUState& state, u16 addr, u16 fontAddress)
+    {
+        if (!_translations[addr].compiled)
+            Compile(state, addr, fontAddress);
+        return _translations[addr];
+    }
+
+    void Invalidate(u16 addr, u16 length);
+    void Flush();
+
+private:
+    static bool CanCompile(u16 opcode);
+    static bool EndsTranslation(u16 opcode);
+    void Compile(const CPUState& state, u16 addr, u16 fontAddress);
+    bool AllocateArena();
+    bool Protect(bool executable);
+
+private:
+    static constexpr size_t ARENA_SIZE = 1024 * 1024;
+    static constexpr u16 MAX_BLOCK_LENGTH = 64;
+
+    u8* _arena = nullptr;
+    size_t _arenaUsed = 0;
+    bool _executable = false;
+
+    std::array<Translation, 4096> _translations{};
+    std::bitset<4096> _translatedCode; // Instruction addresses covered by any translation
+};
@@ -0,0 +1,143 @@
+#include "PixelExpander.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_EXPAND_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define CHIP8_EXPAND_X86 0
+#endif
+
+#if CHIP8_EXPAND_X86 && defined(__GNUC__)
+#define CHIP8_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CHIP8_TARGET_AVX2
+#endif
+
+namespace
+{
+    void ExpandScalar(const u64* words, i32 wordCount, const Palette& palette, u32* out)
+    {
+        for (i32 w = 0; w < wordCount; w++)
+        {
+            const u64 word = words[w];
+            for (i32 bit = 63; bit >= 0; bit--)
+                *out++ = (word >> bit) & 1 ? palette.foreground : palette.background;
+        }
+    }
+
+#if CHIP8_EXPAND_X86
+    void ExpandSSE2(const u64* words, i32 wordCount, const Palette& palette, u32* out)
+    {
+        const __m128i fg = _mm_set1_epi32((i32)palette.foreground);
+        const __m128i bg = _mm_set1_epi32((i32)palette.background);
+        const __m128i high = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+        const __m128i low = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+
+        for (i32 w = 0; w < wordCount; w++)
+        {
+            const u64 word = words[w];
+            for (i32 shift = 56; shift >= 0; shift -= 8)
+            {
+                // Broadcast 8 pixels, turn each lane's bit into an all ones/zeros mask and select
+                const __m128i bits = _mm_set1_epi32((i32)((word >> shift) & 0xFF));
+
+                const __m128i maskHigh = _mm_cmpeq_epi32(_mm_and_si128(bits, high), high);
+                const __m128i maskLow = _mm_cmpeq_epi32(_mm_and_si128(bits, low), low);
+
+                _mm_storeu_si128((__m128i*)out, _mm_or_si128(_mm_and_si128(maskHigh, fg), _mm_andnot_si128(maskHigh, bg)));
+                _mm_storeu_si128((__m128i*)(out + 4), _mm_or_si128(_mm_and_si128(maskLow, fg), _mm_andnot_si128(maskLow, bg)));
+                out += 8;
+            }
+        }
+    }
+
+    CHIP8_TARGET_AVX2 void ExpandAVX2(const u64* words, i32 wordCount, const Palette& palette, u32* out)
+    {
+        const __m256i fg = _mm256_set1_epi32((i32)palette.foreground);
+        const __m256i bg = _mm256_set1_epi32((i32)palette.background);
+        const __m256i lanes = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+        for (i32 w = 0; w < wordCount; w++)
+        {
+            const u64 word = words[w];
+            for (i32 shift = 56; shift >= 0; shift -= 8)
+            {
+                const __m256i bits = _mm256_set1_epi32((i32)((word >> shift) & 0xFF));
+                const __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(bits, lanes), lanes);
+
+                _mm256_storeu_si256((__m256i*)out, _mm256_blendv_epi8(bg, fg, mask));
+                out += 8;
+            }
+        }
+    }
+
+    bool CpuHasAVX2()
+    {
+#if defined(_MSC_VER)
+        i32 info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // AVX2 also needs the OS to save the upper halves of the ymm registers
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+}
+
+void PixelExpander::Expand(const u64* plane, i32 width, i32 firstRow, i32 rowCount, const Palette& palette, u32* out, ExpandKernel kernel)
+{
+    const i32 wordsPerRow = width / 64;
+
+    // Rows are contiguous in both the plane and the output, so the whole range is one run
+    const u64* words = plane + firstRow * wordsPerRow;
+    const i32 wordCount = rowCount * wordsPerRow;
+    out += firstRow * width;
+
+    switch (IsSupported(kernel) ? kernel : ExpandKernel::Scalar)
+    {
+#if CHIP8_EXPAND_X86
+    case ExpandKernel::SSE2: ExpandSSE2(words, wordCount, palette, out); break;
+    case ExpandKernel::AVX2: ExpandAVX2(words, wordCount, palette, out); break;
+#endif
+    default: ExpandScalar(words, wordCount, palette, out); break;
+    }
+}
+
+bool PixelExpander::IsSupported(ExpandKernel kernel)
+{
+    switch (kernel)
+    {
+    case ExpandKernel::Scalar: return true;
+#if CHIP8_EXPAND_X86
+    case ExpandKernel::SSE2: return true;
+    case ExpandKernel::AVX2:
+    {
+        static const bool avx2 = CpuHasAVX2();
+        return avx2;
+    }
+#endif
+    default: return false;
+    }
+}
+
+ExpandKernel PixelExpander::GetBestKernel()
+{
+    if (IsSupported(ExpandKernel::AVX2))
+        return ExpandKernel::AVX2;
+    if (IsSupported(ExpandKernel::SSE2))
+        return ExpandKernel::SSE2;
+    return ExpandKernel::Scalar;
+}
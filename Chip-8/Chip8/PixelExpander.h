@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Types.h"
+
+// Colors are RGBA bytes in memory order, as uploaded with GL_RGBA / GL_UNSIGNED_BYTE
+struct Palette
+{
+    u32 foreground = 0xFFFFFFFF;
+    u32 background = 0x00000000;
+};
+
+enum class ExpandKernel : u8
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Expands 1 bit per pixel planes into RGBA. Each row of the plane is width / 64 words
+// and bit 63 of a word is its leftmost pixel, which is the layout of CPUState::_screen.
+class PixelExpander
+{
+public:
+    // Writes rows [firstRow, firstRow + rowCount) of a width pixels wide image, width a multiple of 64
+    static void Expand(const u64* plane, i32 width, i32 firstRow, i32 rowCount, const Palette& palette, u32* out, ExpandKernel kernel);
+    static void Expand(const u64* plane, i32 width, i32 firstRow, i32 rowCount, const Palette& palette, u32* out)
+    {
+        Expand(plane, width, firstRow, rowCount, palette, out, GetBestKernel());
+    }
+
+    static bool IsSupported(ExpandKernel kernel);
+    static ExpandKernel GetBestKernel();
+};
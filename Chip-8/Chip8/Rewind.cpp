@@ -0,0 +1,220 @@
+#include "Rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Unchanged runs shorter than this cost less as changed bytes than as a new run header
+    constexpr size_t MIN_UNCHANGED_RUN = 4;
+
+    // A run header per MIN_UNCHANGED_RUN bytes at worst, plus the last header
+    constexpr size_t MAX_ENCODED_SIZE = sizeof(Chip8Snapshot) * 2 + 4;
+}
+
+Rewind::Rewind(size_t capacity, u32 keyframeInterval)
+    : _keyframeInterval(std::max(1u, keyframeInterval))
+{
+    _scratch.resize(MAX_ENCODED_SIZE);
+    SetCapacity(capacity);
+}
+
+void Rewind::Clear()
+{
+    _records.clear();
+    _writePos = 0;
+    _used = 0;
+    _sinceKeyframe = 0;
+}
+
+void Rewind::SetCapacity(size_t bytes)
+{
+    // Room for a keyframe that doesn't compress at all, and something to go back to
+    _ring.assign(std::max(bytes, MAX_ENCODED_SIZE * 2), 0);
+    _ring.shrink_to_fit();
+    Clear();
+}
+
+void Rewind::Push(const Chip8Snapshot& state)
+{
+    const u8* bytes = reinterpret_cast<const u8*>(&state);
+    u8* latest = reinterpret_cast<u8*>(&_latest);
+
+    bool keyframe = _records.empty() || _sinceKeyframe >= _keyframeInterval;
+    size_t size = Encode(bytes, keyframe ? nullptr : latest, _scratch.data());
+
+    size_t offset = 0;
+    if (!Reserve(size, offset))
+        return; // Fails, the frame is dropped
+
+    // Making room evicted the keyframe this delta depends on
+    if (!keyframe && _records.empty())
+    {
+        keyframe = true;
+        size = Encode(bytes, nullptr, _scratch.data());
+        if (!Reserve(size, offset))
+            return; // Fails, the frame is dropped
+    }
+
+    std::memcpy(_ring.data() + offset, _scratch.data(), size);
+    _records.push_back({ offset, (u32)size, keyframe });
+    _writePos = offset + size;
+    _used += size;
+    _sinceKeyframe = keyframe ? 1 : _sinceKeyframe + 1;
+
+    std::memcpy(latest, bytes, SNAPSHOT_SIZE);
+}
+
+bool Rewind::StepBack(Chip8Snapshot& out)
+{
+    if (_records.size() < 2)
+        return false; // Fails
+
+    const Record newest = _records.back();
+    _records.pop_back();
+    _writePos = newest.offset;
+    _used -= newest.size;
+
+    // XOR is its own inverse, so a delta undoes itself. A keyframe has nothing to undo against.
+    if (newest.keyframe)
+        Rebuild(_records.size() - 1);
+    else
+        Decode(_ring.data() + newest.offset, newest.size, reinterpret_cast<u8*>(&_latest));
+
+    _sinceKeyframe = 0;
+    for (auto it = _records.rbegin(); it != _records.rend(); ++it)
+    {
+        _sinceKeyframe++;
+        if (it->keyframe)
+            break;
+    }
+
+    out = _latest;
+    return true;
+}
+
+void Rewind::Rebuild(size_t newest)
+{
+    size_t first = newest;
+    while (!_records[first].keyframe)
+        first--;
+
+    u8* latest = reinterpret_cast<u8*>(&_latest);
+    std::memset(latest, 0, SNAPSHOT_SIZE);
+    for (size_t i = first; i <= newest; i++)
+        Decode(_ring.data() + _records[i].offset, _records[i].size, latest);
+}
+
+bool Rewind::Fits(size_t offset, size_t size) const
+{
+    if (offset + size > _ring.size())
+        return false;
+    if (_records.empty())
+        return true;
+
+    // Live records run from the oldest to _writePos, possibly wrapping around the end
+    const size_t oldest = _records.front().offset;
+    if (_writePos > oldest)
+        return offset >= _writePos || offset + size <= oldest;
+    return offset >= _writePos && offset + size <= oldest;
+}
+
+bool Rewind::Reserve(size_t size, size_t& offset)
+{
+    while (true)
+    {
+        if (Fits(_writePos, size))
+        {
+            offset = _writePos;
+            return true;
+        }
+
+        // Not enough room before the end, the tail of the ring goes unused this lap
+        if (Fits(0, size))
+        {
+            offset = 0;
+            return true;
+        }
+
+        if (_records.empty())
+            return false; // Fails
+
+        EvictOldestGroup();
+    }
+}
+
+void Rewind::EvictOldestGroup()
+{
+    do
+    {
+        _used -= _records.front().size;
+        _records.pop_front();
+    } while (!_records.empty() && !_records.front().keyframe);
+
+    if (_records.empty())
+    {
+        _writePos = 0;
+        _sinceKeyframe = 0;
+    }
+}
+
+size_t Rewind::Encode(const u8* data, const u8* reference, u8* out)
+{
+    auto changed = [&](size_t i) -> u8 { return reference ? data[i] ^ reference[i] : data[i]; };
+
+    u8* o = out;
+    size_t i = 0;
+    while (i < SNAPSHOT_SIZE)
+    {
+        const size_t unchangedStart = i;
+        while (i < SNAPSHOT_SIZE && !changed(i))
+            i++;
+        const u16 unchanged = (u16)(i - unchangedStart);
+
+        const size_t changedStart = i;
+        while (i < SNAPSHOT_SIZE)
+        {
+            if (changed(i))
+            {
+                i++;
+                continue;
+            }
+
+            size_t end = i;
+            while (end < SNAPSHOT_SIZE && end - i < MIN_UNCHANGED_RUN && !changed(end))
+                end++;
+            if (end - i >= MIN_UNCHANGED_RUN || end == SNAPSHOT_SIZE)
+                break;
+
+            // Too short to be worth a header, carried along as changed bytes
+            i = end;
+        }
+        const u16 count = (u16)(i - changedStart);
+
+        std::memcpy(o, &unchanged, sizeof(u16));
+        std::memcpy(o + 2, &count, sizeof(u16));
+        o += 4;
+
+        for (size_t k = changedStart; k < i; k++)
+            *o++ = changed(k);
+    }
+
+    return (size_t)(o - out);
+}
+
+void Rewind::Decode(const u8* in, size_t size, u8* data)
+{
+    const u8* end = in + size;
+    size_t pos = 0;
+    while (in < end)
+    {
+        u16 unchanged, count;
+        std::memcpy(&unchanged, in, sizeof(u16));
+        std::memcpy(&count, in + 2, sizeof(u16));
+        in += 4;
+
+        pos += unchanged;
+        for (u16 k = 0; k < count; k++)
+            data[pos++] ^= *in++;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Types.h"
+#include "Snapshot.h"
+
+#include <deque>
+#include <vector>
+
+// History of Chip8 snapshots in a fixed amount of memory, one per frame, for stepping
+// backwards. Every keyframeInterval frames a whole snapshot is kept, frames in between
+// only keep what changed since the frame before: the XOR of the two, run-length encoded.
+// Most of memory and the screen are the same from one frame to the next, so that is mostly zeros.
+//
+// Frames live back to back in one ring of bytes. When it fills up the oldest keyframe
+// goes, along with the frames that depend on it.
+class Rewind
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 16 * 1024 * 1024;
+    static constexpr u32 DEFAULT_KEYFRAME_INTERVAL = 60;
+
+    Rewind(size_t capacity = DEFAULT_CAPACITY, u32 keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+
+    void Clear();
+    // Clears the history, at least a couple of whole snapshots are always kept
+    void SetCapacity(size_t bytes);
+
+    // Records the state at the end of a frame. A frame that can't be made room for is dropped,
+    // though SetCapacity's minimum always leaves room for one.
+    void Push(const Chip8Snapshot& state);
+    // Forgets the newest frame and writes the one before it to out. Fails if there is none.
+    bool StepBack(Chip8Snapshot& out);
+
+    const size_t GetFrameCount() const { return _records.size(); }
+    const size_t GetCapacity() const { return _ring.size(); }
+    const size_t GetUsedBytes() const { return _used; }
+    // Size of the frames held as whole snapshots over the bytes they actually take
+    const f64 GetCompressionRatio() const { return _used ? (f64)_records.size() * sizeof(Chip8Snapshot) / _used : 0.0; }
+
+private:
+    struct Record
+    {
+        size_t offset = 0; // Into _ring
+        u32 size = 0;
+        bool keyframe = false;
+    };
+
+    // Run-length encodes data XOR reference, or data itself with no reference.
+    // Runs are [u16 unchanged bytes][u16 changed bytes][changed bytes XOR reference].
+    static size_t Encode(const u8* data, const u8* reference, u8* out);
+    // XORs an encoded frame into data
+    static void Decode(const u8* in, size_t size, u8* data);
+
+    bool Fits(size_t offset, size_t size) const;
+    bool Reserve(size_t size, size_t& offset);
+    void EvictOldestGroup();
+    void Rebuild(size_t newest); // Decodes _latest from the keyframe at or before newest
+
+    static constexpr size_t SNAPSHOT_SIZE = sizeof(Chip8Snapshot);
+    static_assert(SNAPSHOT_SIZE < 0xFFFF, "Run lengths are stored as u16");
+
+    std::vector<u8> _ring;
+    size_t _writePos = 0; // Just past the newest record
+    size_t _used = 0;
+    std::deque<Record> _records; // Oldest first, the oldest is always a keyframe
+
+    u32 _keyframeInterval;
+    u32 _sinceKeyframe = 0;
+
+    Chip8Snapshot _latest{}; // The newest frame, decoded
+    std::vector<u8> _scratch; // Encoder output, sized for the worst case
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Types.h"
+#include "CPUState.h"
+#include "Random.h"
+
+#include <type_traits>
+
+// Everything a CPU needs to carry on exactly where it was saved. Decoded and
+// compiled code isn't included, it only depends on memory and is kept or rebuilt on load.
+struct CPUSnapshot
+{
+    CPUState state;
+    Random random;
+};
+
+// A whole emulator as written by Chip8::SaveState. Plain data, so taking and restoring
+// one is a copy. The layout is only stable within one build and version.
+struct Chip8Snapshot
+{
+    static constexpr u32 MAGIC = 0x53533843; // "C8SS"
+    static constexpr u32 VERSION = 3;
+
+    u32 magic = MAGIC;
+    u32 version = VERSION;
+    u32 size = sizeof(Chip8Snapshot);
+
+    CPUSnapshot cpu;
+
+    u32 cyclesSinceTick = 0;
+    u64 totalCycles = 0;
+    u64 timerTicks = 0;
+
+    bool IsValid() const { return magic == MAGIC && version == VERSION && size == sizeof(Chip8Snapshot); }
+};
+
+static_assert(std::is_trivially_copyable_v<Chip8Snapshot>);
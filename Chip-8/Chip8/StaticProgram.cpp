@@ -0,0 +1,28 @@
+#include "StaticProgram.h"
+
+#include <cstring>
+#include <vector>
+
+static std::vector<const StaticProgram*>& Registry()
+{
+    // Function local so generated sources can register before main regardless of init order
+    static std::vector<const StaticProgram*> programs;
+    return programs;
+}
+
+bool StaticProgram::Register(const StaticProgram* program)
+{
+    Registry().push_back(program);
+    return true;
+}
+
+const StaticProgram* StaticProgram::Find(const u8* rom, size_t romSize)
+{
+    for (const StaticProgram* program : Registry())
+    {
+        if (program->romSize == romSize && std::memcmp(program->rom, rom, romSize) == 0)
+            return program;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Types.h"
+#include "CPUState.h"
+
+#include <cstddef>
+
+// A run of instructions recompiled ahead of time by Chip8Recompiler.
+// Leaves PC at the next instruction, like the interpreter would after length cycles.
+struct StaticBlock
+{
+    u16 addr;
+    u16 length; // Instructions
+    void (*fn)(CPUState& state);
+};
+
+// A ROM recompiled ahead of time. Generated sources register themselves during
+// static initialization and CPU::Reset binds the program whose ROM is being loaded.
+struct StaticProgram
+{
+    const char* name;
+    const u8* rom;
+    size_t romSize;
+    const StaticBlock* blocks;
+    size_t blockCount;
+
+    static bool Register(const StaticProgram* program);
+    static const StaticProgram* Find(const u8* rom, size_t romSize);
+};
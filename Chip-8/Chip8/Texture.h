@@ -48,6 +48,14 @@ public:
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
+    // Uploads rows [firstRow, firstRow + rowCount) of a full size image
+    void UpdateRows(const u32* pixels, i32 firstRow, i32 rowCount) const
+    {
+        glBindTexture(GL_TEXTURE_2D, _id);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, _w, rowCount, GL_RGBA, GL_UNSIGNED_BYTE, pixels + firstRow * _w);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
     void Bind(u32 unit = 0) const
     {
         glActiveTexture(GL_TEXTURE0 + unit);
@@ -3,7 +3,11 @@
 #include "Window.h"
 #include "Texture.h"
 #include "Chip8.h"
+#include "EmuThread.h"
 #include "DebugWindow.h"
+#include "WaveOutAudioSink.h"
+
+#include <bit>
 
 Application::Application()
 {
@@ -18,19 +22,41 @@ Application::~Application()
     delete _screenTexture;
     _screenTexture = nullptr;
 
+    // Stops the emulation thread, so it has to go before the chip it runs
+    _window->SetUserPtr(nullptr);
+    delete _emu;
+    _emu = nullptr;
+
     delete _chip;
     _chip = nullptr;
 
+    delete _audio;
+    _audio = nullptr;
+
     delete _window;
     _window = nullptr;
 }
 
 void Application::Run()
 {
+    // Sleeps until the emulation publishes a frame or the user does something, and only draws
+    // then, so a paused or waiting emulator costs next to nothing
     while (!_window->ShouldClose())
     {
-        Update();
-        Render();
+        const bool newFrame = Update();
+
+        const Clock::time_point now = Clock::now();
+        const bool settling = now < _settleUntil;
+        if (newFrame || (settling && now >= _nextUiFrame))
+        {
+            Render();
+            _nextUiFrame = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<f64>(UI_FRAME_SECONDS));
+        }
+
+        if (settling)
+            _window->WaitEvents(std::chrono::duration<f64>(_nextUiFrame - Clock::now()).count());
+        else
+            _window->WaitEvents(IDLE_WAIT_SECONDS);
     }
 }
 
@@ -39,23 +65,79 @@ void Application::Init()
     _window = new Window();
     _chip = new Chip8();
 
-    _window->SetUserPtr(_chip);
+#if defined(_WIN32)
+    _audio = new WaveOutAudioSink();
+#else
+    _audio = new NullAudioSink();
+#endif
+    _chip->SetAudioSink(_audio);
+
+    _emu = new EmuThread(_chip, [] { Window::Wake(); });
+    _window->SetUserPtr(_emu);
 
     _screenTexture = new Texture();
     _screenTexture->CreateEmpty(64, 32);
 
-    _debugWindow = new DebugWindow(_window, _chip);
+    _debugWindow = new DebugWindow(_window, _emu);
 }
 
-void Application::Update()
+bool Application::Update()
 {
-    _window->Clear();
-    _chip->Cycle();
-    _screenTexture->Update(_chip->GetCPU()->GetPixelData());
+    const bool newFrame = _emu->Update();
+
+    if (Window::ConsumeInput() || _window->ConsumeRedraw())
+        _settleUntil = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<f64>(UI_SETTLE_SECONDS));
+
+    return newFrame;
+}
+
+void Application::UploadScreen()
+{
+    // Rows changed in frames that were skipped count too
+    const EmuFrame& frame = _emu->GetFrame();
+    u64 rows = frame.RowsChangedSince(_uploadedFrame);
+    _uploadedFrame = frame.index;
+
+    // A palette change recolors every pixel
+    const Palette& palette = _debugWindow->GetPalette();
+    if (palette.foreground != _palette.foreground || palette.background != _palette.background)
+    {
+        _palette = palette;
+        rows = CPU::ALL_ROWS;
+    }
+
+    // One upload per run of consecutive dirty rows
+    while (rows)
+    {
+        const i32 first = std::countr_zero(rows);
+        const i32 count = std::countr_one(rows >> first);
+
+        PixelExpander::Expand(frame.state._screen.data(), CPU::SCREEN_WIDTH, first, count, _palette, _pixels.data());
+        _screenTexture->UpdateRows(_pixels.data(), first, count);
+
+        rows &= ~((count == 64 ? ~0ull : (1ull << count) - 1) << first);
+    }
 }
 
 void Application::Render()
 {
+    const Clock::time_point start = Clock::now();
+
+    _window->Clear();
+    UploadScreen();
     _debugWindow->Render(_screenTexture);
-    _window->Render();
+
+    _renderSeconds += std::chrono::duration<f64>(Clock::now() - start).count();
+    _statsFrames++;
+
+    _window->Present();
+
+    const f64 window = std::chrono::duration<f64>(Clock::now() - _statsStart).count();
+    if (window >= STATS_WINDOW_SECONDS)
+    {
+        _debugWindow->SetRenderStats(_statsFrames / window, _renderSeconds * 1000.0 / _statsFrames);
+        _statsStart = Clock::now();
+        _statsFrames = 0;
+        _renderSeconds = 0.0;
+    }
 }
@@ -1,13 +1,18 @@
 #pragma once
 
 #include "Types.h"
+#include "PixelExpander.h"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
 
 class Window;
 class Texture;
 class Chip8;
+class EmuThread;
 class DebugWindow;
+class AudioSink;
 
 class Application
 {
@@ -18,13 +23,38 @@ public:
     void Run();
 
 private:
+    using Clock = std::chrono::steady_clock;
+
+    // After input the UI keeps redrawing this long, for hover delays and the like to play out
+    static constexpr f64 UI_SETTLE_SECONDS = 0.5;
+    // Redraws for the UI alone are capped at the emulated frame rate
+    static constexpr f64 UI_FRAME_SECONDS = 1.0 / 60.0;
+    // Longest sleep with nothing to do. New frames and input end it early anyway.
+    static constexpr f64 IDLE_WAIT_SECONDS = 0.5;
+    // Window the frame rate and render time shown in the UI are averaged over
+    static constexpr f64 STATS_WINDOW_SECONDS = 0.5;
+
     void Init();
-    void Update();
+    bool Update();
+    void UploadScreen();
     void Render();
 
 private:
     Window* _window = nullptr;
     Chip8* _chip = nullptr;
+    EmuThread* _emu = nullptr;
     Texture* _screenTexture = nullptr;
     DebugWindow* _debugWindow = nullptr;
+    AudioSink* _audio = nullptr;
+
+    std::array<u32, 64 * 32> _pixels{};
+    Palette _palette;
+    u64 _uploadedFrame = 0;
+
+    Clock::time_point _settleUntil{};
+    Clock::time_point _nextUiFrame{};
+
+    Clock::time_point _statsStart{};
+    u32 _statsFrames = 0;
+    f64 _renderSeconds = 0.0; // Building and submitting frames since _statsStart, not waiting on vsync
 };
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 #include "Texture.h"
 #include "Window.h"
-#include "Chip8.h"
+#include "EmuThread.h"
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -12,8 +12,8 @@
 #include <backends/imgui_impl_opengl3.h>
 #include <imgui_internal.h>
 
-DebugWindow::DebugWindow(Window* window, Chip8* chip)
-    : _window(window), _chip(chip)
+DebugWindow::DebugWindow(Window* window, EmuThread* emu)
+    : _window(window), _emu(emu)
 {
     Init();
 }
@@ -72,7 +72,10 @@ void DebugWindow::Init()
         style.Colors[ImGuiCol_WindowBg].w = 1.0f;
     }
 
+    // The Window's callbacks were set first, so ImGui chains to them. For every window, so
+    // input on a detached viewport still wakes the frontend.
     ImGui_ImplGlfw_InitForOpenGL(_window->GetHandle(), true);
+    ImGui_ImplGlfw_SetCallbacksChainForAllWindows(true);
     ImGui_ImplOpenGL3_Init("#version 460");
 
     ScanRoms();
@@ -182,14 +185,29 @@ void DebugWindow::DebugCPU()
         if (ImGui::BeginTable("cpu", 4, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg))
         {
             ImGui::TableNextRow(); ImGui::TableNextColumn(); ImGui::TextUnformatted("PC");
-            ImGui::TableNextColumn(); ImGui::Text("0x%03X", _chip->GetCPU()->GetPC());
+            ImGui::TableNextColumn(); ImGui::Text("0x%03X", _emu->GetCPU()->GetPC());
             ImGui::TableNextColumn(); ImGui::TextUnformatted("I");
-            ImGui::TableNextColumn(); ImGui::Text("0x%03X", _chip->GetCPU()->GetIndex());
+            ImGui::TableNextColumn(); ImGui::Text("0x%03X", _emu->GetCPU()->GetIndex());
 
             ImGui::TableNextRow(); ImGui::TableNextColumn(); ImGui::TextUnformatted("DT");
-            ImGui::TableNextColumn(); ImGui::Text("%u", _chip->GetCPU()->GetDelayTimer());
+            ImGui::TableNextColumn(); ImGui::Text("%u", _emu->GetCPU()->GetDelayTimer());
             ImGui::TableNextColumn(); ImGui::TextUnformatted("ST");
-            ImGui::TableNextColumn(); ImGui::Text("%u", _chip->GetCPU()->GetSoundTimer());
+            ImGui::TableNextColumn(); ImGui::Text("%u", _emu->GetCPU()->GetSoundTimer());
+
+            ImGui::TableNextRow(); ImGui::TableNextColumn(); ImGui::TextUnformatted("Cycles");
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)_emu->GetTotalCycles());
+            ImGui::TableNextColumn(); ImGui::TextUnformatted("Time");
+            ImGui::TableNextColumn(); ImGui::Text("%.2fs", _emu->GetEmulatedSeconds());
+
+            // Share of the cycles spent waiting on DT or keys, and skipped rather than run
+            const u64 cycles = _emu->GetTotalCycles();
+            ImGui::TableNextRow(); ImGui::TableNextColumn(); ImGui::TextUnformatted("Idle");
+            ImGui::TableNextColumn(); ImGui::Text("%.1f%%", cycles ? 100.0 * _emu->GetIdleCycles() / cycles : 0.0);
+            ImGui::TableNextColumn(); ImGui::TextUnformatted("Skip");
+            ImGui::TableNextColumn();
+            bool idleSkip = _emu->IsIdleSkipEnabled();
+            if (ImGui::Checkbox("##IdleSkip", &idleSkip))
+                _emu->SetIdleSkip(idleSkip);
 
             for (u8 row = 0; row < 2; row++)
             {
@@ -200,7 +218,7 @@ void DebugWindow::DebugCPU()
                     ImGui::TableNextColumn();
                     ImGui::Text("V%X", r);
                     ImGui::TableNextColumn();
-                    ImGui::Text("0x%02X", _chip->GetCPU()->GetVRegister(r));
+                    ImGui::Text("0x%02X", _emu->GetCPU()->GetVRegister(r));
                 }
             }
             ImGui::EndTable();
@@ -214,8 +232,8 @@ void DebugWindow::DebugStack()
 {
     if (ImGui::CollapsingHeader("Stack", ImGuiTreeNodeFlags_DefaultOpen))
     {
-        const u16* st = _chip->GetCPU()->GetStack();
-        const i32 sp = _chip->GetCPU()->GetSP();
+        const u16* st = _emu->GetCPU()->GetStack();
+        const i32 sp = _emu->GetCPU()->GetSP();
         if (ImGui::BeginTable("stack", 2, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg))
         {
             ImGui::TableSetupColumn("Idx"); ImGui::TableSetupColumn("Addr");
@@ -238,7 +256,7 @@ void DebugWindow::DebugDisassembly()
 {
     if (ImGui::CollapsingHeader("Disassembly", ImGuiTreeNodeFlags_DefaultOpen))
     {
-        const u16 pc = _chip->GetCPU()->GetPC();
+        const u16 pc = _emu->GetCPU()->GetPC();
         const i32 linesBefore = 6;
         const i32 linesAfter = 12;
 
@@ -249,10 +267,10 @@ void DebugWindow::DebugDisassembly()
             ImGui::TableSetupColumn("Mnemonic");
             ImGui::TableHeadersRow();
 
-            auto rd = [&](u16 addr)->u16 { return _chip->GetCPU()->PeekOpcode(addr); };
+            auto rd = [&](u16 addr)->u16 { return _emu->GetCPU()->PeekOpcode(addr); };
 
             const u16 start = (pc > linesBefore * 2) ? pc - linesBefore * 2 : 0;
-            const u16 end = (u16)ImMin<size_t>(pc + linesAfter * 2, _chip->GetCPU()->GetMemorySize() - 2);
+            const u16 end = (u16)ImMin<size_t>(pc + linesAfter * 2, _emu->GetCPU()->GetMemorySize() - 2);
 
             for (u16 addr = start; addr <= end; addr += 2)
             {
@@ -271,7 +289,7 @@ void DebugWindow::DebugDisassembly()
                     ImGui::Text("  0x%03X", addr);
 
                 ImGui::TableNextColumn(); ImGui::Text("0x%04X", op);
-                ImGui::TableNextColumn(); ImGui::TextUnformatted(_chip->GetCPU()->Disassemble(addr).c_str());
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(_emu->GetCPU()->Disassemble(addr).c_str());
             }
             ImGui::EndTable();
         }
@@ -284,8 +302,8 @@ void DebugWindow::DebugMemory()
 {
     if (ImGui::CollapsingHeader("Memory (near PC & I)", ImGuiTreeNodeFlags_DefaultOpen))
     {
-        const u8* mem = _chip->GetCPU()->GetMemory();
-        size_t memSize = _chip->GetCPU()->GetMemorySize();
+        const u8* mem = _emu->GetCPU()->GetMemory();
+        size_t memSize = _emu->GetCPU()->GetMemorySize();
 
         auto hexRow = [&](u16 base)
             {
@@ -309,8 +327,8 @@ void DebugWindow::DebugMemory()
                 }
             };
 
-        const u16 pc = _chip->GetCPU()->GetPC();
-        const u16 i = _chip->GetCPU()->GetIndex();
+        const u16 pc = _emu->GetCPU()->GetPC();
+        const u16 i = _emu->GetCPU()->GetIndex();
 
         hexRow(pc & ~0xF);
         hexRow(i & ~0xF);
@@ -323,7 +341,7 @@ void DebugWindow::DebugKeypad()
 {
     if (ImGui::CollapsingHeader("Keypad", ImGuiTreeNodeFlags_DefaultOpen))
     {
-        auto isDown = [&](i32 k)->bool { return _chip->GetCPU()->IsKeyDown(k); };
+        auto isDown = [&](i32 k)->bool { return _emu->GetCPU()->IsKeyDown(k); };
 
         const u8 keysHex[16] =
         {
@@ -350,7 +368,7 @@ void DebugWindow::DebugKeypad()
 
                 ImGui::TableNextColumn();
 
-                bool down = _chip->GetCPU()->IsKeyDown(keysHex[i]);
+                bool down = _emu->GetCPU()->IsKeyDown(keysHex[i]);
 
                 ImGui::PushStyleColor(ImGuiCol_Button, down ? ImVec4(0.25f, 0.55f, 1.0f, 1.0f) : ImVec4(0.2f, 0.2f, 0.2f, 1.0f));
                 ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.35f, 0.65f, 1.0f, 1.0f));
@@ -428,14 +446,16 @@ void DebugWindow::RomPicker()
         if (ImGui::Button("Load"))
         {
             //_paused = true;
-            _chip->Reset();
-            _chip->LoadROM(_roms[_romIndex].string());
+            _emu->Reset();
+            _emu->LoadROM(_roms[_romIndex].string());
+            _loadedRom = _roms[_romIndex];
         }
         ImGui::SameLine();
         if (ImGui::Button("Reload"))
         {
-            _chip->Reset();
-            _chip->LoadROM(_roms[_romIndex].string());
+            _emu->Reset();
+            _emu->LoadROM(_roms[_romIndex].string());
+            _loadedRom = _roms[_romIndex];
         }
 
         if (!canLoad) ImGui::EndDisabled();
@@ -450,16 +470,16 @@ void DebugWindow::RomPicker()
 
 void DebugWindow::ToolBar()
 {
-    bool paused = _chip->IsPaused();
+    bool paused = _emu->IsPaused();
     if (ImGui::Button(paused ? "Play" : "Pause"))
     {
-        if (!_chip->GetROMSize())
+        if (!_emu->GetROMSize())
         {
             ImGui::OpenPopup("NoROMLoaded");
             return;
         }
 
-        _chip->TogglePaused();
+        _emu->TogglePaused();
     }
 
     ImGui::SetNextWindowPos(ImVec2(_window->GetWidth() / 2.0f, _window->GetHeight() / 2.0f));
@@ -477,7 +497,7 @@ void DebugWindow::ToolBar()
     if (paused)
     {
         if (ImGui::Button("Step"))
-            _chip->StepOnce();
+            _emu->StepOnce();
 
         ImGui::SameLine();
     }
@@ -489,18 +509,212 @@ void DebugWindow::ToolBar()
         ImGui::SameLine();
     }
 
-    i32 cpf = _chip->GetCyclesPerFrame();
-    ImGui::SetNextItemWidth(160);
-    if (ImGui::SliderInt("Cycles/frame", &cpf, 1, 2000))
-        _chip->SetCyclesPerFrame(cpf);
+    RewindControl();
+    ImGui::SameLine();
+    RecordControl();
+    ImGui::SameLine();
+
+    ClockControl();
+    ImGui::SameLine();
+    PerformanceReadout();
+
+    const char* dispatchModes[] = { "Switch", "Table", "Cached", "Block", "JIT", "Static", "Threaded" };
+    const i32 mode = (i32)_emu->GetCPU()->GetDispatchMode();
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100);
+    if (ImGui::BeginCombo("Dispatch", dispatchModes[mode]))
+    {
+        for (i32 i = 0; i < IM_ARRAYSIZE(dispatchModes); i++)
+        {
+            // Engines that aren't available would only fall back to the interpreter
+            bool available = true;
+            if ((DispatchMode)i == DispatchMode::Jit)
+                available = Jit::IsSupported();
+            else if ((DispatchMode)i == DispatchMode::Static)
+                available = _emu->GetCPU()->GetStaticProgram() != nullptr;
+            else if ((DispatchMode)i == DispatchMode::Threaded)
+                available = CPU::HasThreadedDispatch();
+
+            if (!available)
+                ImGui::BeginDisabled();
+            if (ImGui::Selectable(dispatchModes[i], i == mode))
+                _emu->SetDispatchMode((DispatchMode)i);
+            if (!available)
+                ImGui::EndDisabled();
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+    PaletteEditor();
 
     if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows))
     {
         if (ImGui::IsKeyPressed(ImGuiKey_Space))
-            _chip->TogglePaused();
-        if (ImGui::IsKeyPressed(ImGuiKey_F10) && _chip->IsPaused())
-            _chip->StepOnce();
+            _emu->TogglePaused();
+        if (ImGui::IsKeyPressed(ImGuiKey_F10) && _emu->IsPaused())
+            _emu->StepOnce();
+        if (ImGui::IsKeyDown(ImGuiKey_Backspace))
+            _emu->StepBack();
     }
 
     ImGui::Separator();
 }
+
+void DebugWindow::ClockControl()
+{
+    const EmuFrame& frame = _emu->GetFrame();
+    const bool timed = frame.clockMode == ClockMode::InstructionsPerSecond;
+
+    // Scripts are only exact at the rate they were recorded at
+    const bool scripted = _emu->IsRecording() || _emu->IsReplaying();
+    if (scripted)
+        ImGui::BeginDisabled();
+
+    const char* clockModes[] = { "Cycles/frame", "Instr/s" };
+    i32 clockMode = (i32)frame.clockMode;
+    ImGui::SetNextItemWidth(110);
+    if (ImGui::Combo("##ClockMode", &clockMode, clockModes, IM_ARRAYSIZE(clockModes)))
+        _emu->SetClockMode((ClockMode)clockMode);
+
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(160);
+    if (timed)
+    {
+        i32 ips = (i32)frame.instructionsPerSecond;
+        if (ImGui::SliderInt("##IPS", &ips, (i32)Chip8::MIN_IPS, (i32)Chip8::MAX_IPS, "%d Hz", ImGuiSliderFlags_Logarithmic))
+            _emu->SetInstructionsPerSecond((u32)ips);
+    }
+    else
+    {
+        i32 cpf = frame.cyclesPerFrame;
+        if (ImGui::SliderInt("##CPF", &cpf, 1, 2000))
+            _emu->SetCyclesPerFrame(cpf);
+    }
+
+    if (scripted)
+        ImGui::EndDisabled();
+
+    // Turbo ignores the clock, but keeps its setting for when it's switched off again
+    ImGui::SameLine();
+    bool turbo = frame.turbo;
+    if (ImGui::Checkbox("Turbo", &turbo))
+        _emu->SetTurbo(turbo);
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Run as fast as the host allows, the display still updates at 60 Hz");
+
+    // What the host actually manages against what was asked for
+    const f64 target = timed ? (f64)frame.instructionsPerSecond : (f64)frame.cyclesPerFrame * Chip8::TIMER_HZ;
+    ImGui::SameLine();
+    if (frame.turbo)
+        ImGui::Text("%.2f MIPS", frame.achievedIps / 1e6);
+    else
+        ImGui::Text("%.2f / %.2f MIPS", frame.achievedIps / 1e6, target / 1e6);
+    if (ImGui::IsItemHovered())
+    {
+        ImGui::BeginTooltip();
+        ImGui::Text("Achieved %.0f instructions/s", frame.achievedIps);
+        if (!frame.turbo)
+            ImGui::Text("Target %.0f instructions/s", target);
+        if (timed)
+            ImGui::Text("%llu dropped to keep up", (unsigned long long)frame.droppedCycles);
+        ImGui::EndTooltip();
+    }
+}
+
+void DebugWindow::PerformanceReadout()
+{
+    // Emulation time is per published frame, render time per drawn one, so the two compare directly
+    const EmuFrame& frame = _emu->GetFrame();
+    ImGui::TextDisabled("%.0f fps | emu %.2f ms | render %.2f ms", _renderFps, frame.emulationMs, _renderMs);
+    if (ImGui::IsItemHovered())
+    {
+        ImGui::BeginTooltip();
+        ImGui::Text("Frames drawn: %.1f/s", _renderFps);
+        ImGui::Text("Emulation thread running: %.2f ms per frame", frame.emulationMs);
+        ImGui::Text("UI build and submit: %.2f ms per frame", _renderMs);
+        ImGui::EndTooltip();
+    }
+
+    // Only ever happens if the emulation thread stalls, and a lost KeyUp leaves a key stuck
+    if (const u64 dropped = _emu->GetDroppedCommands())
+    {
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "| %llu commands dropped", (unsigned long long)dropped);
+    }
+}
+
+void DebugWindow::RewindControl()
+{
+    const EmuFrame& frame = _emu->GetFrame();
+
+    // Held down it keeps going back, a frame per UI frame
+    const bool canRewind = frame.rewindFrames > 1;
+    if (!canRewind)
+        ImGui::BeginDisabled();
+    ImGui::Button("Rewind");
+    if (ImGui::IsItemActive())
+        _emu->StepBack();
+    if (!canRewind)
+        ImGui::EndDisabled();
+
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+    {
+        ImGui::BeginTooltip();
+        ImGui::Text("%zu frames (%.1fs)", frame.rewindFrames, (f64)frame.rewindFrames / Chip8::TIMER_HZ);
+        ImGui::Text("%.2f / %.0f MiB", frame.rewindUsedBytes / (1024.0 * 1024.0), frame.rewindCapacity / (1024.0 * 1024.0));
+        ImGui::Text("Compression %.1fx", frame.rewindRatio);
+        ImGui::TextUnformatted("Hold to rewind, or hold Backspace");
+        ImGui::EndTooltip();
+    }
+
+    // Resizing clears the history, so only once the slider is let go
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(80);
+    ImGui::SliderInt("MiB", &_rewindMiB, 1, 256);
+    if (ImGui::IsItemDeactivatedAfterEdit())
+        _emu->SetRewindCapacity((size_t)_rewindMiB << 20);
+}
+
+void DebugWindow::RecordControl()
+{
+    // Scripts go next to the ROM, where Chip8Batch picks them up too
+    const bool haveRom = !_loadedRom.empty() && _emu->GetROMSize();
+    const std::string script = _loadedRom.string() + ".input";
+
+    if (!haveRom)
+        ImGui::BeginDisabled();
+
+    if (_emu->IsRecording())
+    {
+        if (ImGui::Button("Stop##Record"))
+            _emu->StopRecording(script);
+    }
+    else if (ImGui::Button("Record"))
+        _emu->StartRecording();
+
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+        ImGui::SetTooltip("Resets with a fixed seed and records every key press\nto %s", haveRom ? script.c_str() : "<rom>.input");
+
+    ImGui::SameLine();
+    if (ImGui::Button(_emu->IsReplaying() ? "Replaying" : "Replay"))
+        _emu->Replay(script);
+
+    if (!haveRom)
+        ImGui::EndDisabled();
+}
+
+void DebugWindow::PaletteEditor()
+{
+    // Palette colors share ImGui's packed layout, R in the lowest byte
+    const ImGuiColorEditFlags flags = ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoAlpha;
+
+    ImVec4 foreground = ImGui::ColorConvertU32ToFloat4(_palette.foreground);
+    if (ImGui::ColorEdit3("##Foreground", &foreground.x, flags))
+        _palette.foreground = ImGui::ColorConvertFloat4ToU32(foreground) | 0xFF000000;
+
+    ImGui::SameLine();
+    ImVec4 background = ImGui::ColorConvertU32ToFloat4(_palette.background);
+    if (ImGui::ColorEdit3("Palette", &background.x, flags))
+        _palette.background = ImGui::ColorConvertFloat4ToU32(background) | 0xFF000000;
+}
@@ -1,23 +1,30 @@
 #pragma once
 
 #include "Types.h"
+#include "PixelExpander.h"
+#include "Rewind.h"
 
 #include <imgui.h>
 
 #include <filesystem>
 
 class Window;
-class Chip8;
+class EmuThread;
 class Texture;
 
 class DebugWindow
 {
 public:
-    DebugWindow(Window* window, Chip8* chip);
+    DebugWindow(Window* window, EmuThread* emu);
     ~DebugWindow();
 
     void Render(Texture* texture);
 
+    const Palette& GetPalette() const { return _palette; }
+
+    // Measured by the frontend, shown next to the emulation's own figures
+    void SetRenderStats(f64 framesPerSecond, f64 renderMs) { _renderFps = framesPerSecond; _renderMs = renderMs; }
+
 private:
     void Init();
 
@@ -35,10 +42,15 @@ private:
     void RomPicker();
 
     void ToolBar();
+    void ClockControl();
+    void PerformanceReadout();
+    void RewindControl();
+    void RecordControl();
+    void PaletteEditor();
 
 private:
     Window* _window = nullptr;
-    Chip8* _chip = nullptr;
+    EmuThread* _emu = nullptr;
 
     bool _firstLoop = true;
     ImVec2 _lastSize = { 0, 0 };
@@ -46,4 +58,11 @@ private:
     std::filesystem::path _romDir;
     std::vector<std::filesystem::path> _roms;
     i32 _romIndex = -1;
+    std::filesystem::path _loadedRom;
+
+    Palette _palette;
+    i32 _rewindMiB = (i32)(Rewind::DEFAULT_CAPACITY >> 20);
+
+    f64 _renderFps = 0.0;
+    f64 _renderMs = 0.0;
 };
\ No newline at end of file
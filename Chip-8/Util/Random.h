@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Types.h"
+
+#include <random>
+
+// Generators for CXNN. Only a byte is drawn at a time, so what matters is that a
+// generator is quick, seedable and small: its state goes into every snapshot and
+// every rewind frame.
+
+// SplitMix64, 8 bytes of state and a handful of multiplies per draw
+class SplitMix64
+{
+public:
+    SplitMix64(u64 seed = 0) : _state(seed) {}
+
+    void Seed(u64 seed) { _state = seed; }
+
+    u64 Next()
+    {
+        u64 z = (_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // The top bits are the best mixed
+    u8 NextByte() { return (u8)(Next() >> 56); }
+
+    bool operator==(const SplitMix64& other) const = default;
+
+private:
+    u64 _state;
+};
+
+// std::mt19937 through uniform_int_distribution, as CXNN used to draw. About 5 KiB of state.
+class MersenneRandom
+{
+public:
+    MersenneRandom(u64 seed = std::mt19937::default_seed) : _engine((u32)seed) {}
+
+    void Seed(u64 seed) { _engine.seed((u32)seed); }
+    u8 NextByte() { return (u8)_dist(_engine); }
+
+    bool operator==(const MersenneRandom& other) const { return _engine == other._engine; }
+
+private:
+    std::mt19937 _engine;
+    std::uniform_int_distribution<u16> _dist{ 0, 255 };
+};
+
+// Define CHIP8_RNG_MT19937 to get the old sequences back, for comparing against older runs
+#if defined(CHIP8_RNG_MT19937)
+using Random = MersenneRandom;
+#else
+using Random = SplitMix64;
+#endif
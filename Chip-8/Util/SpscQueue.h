@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Types.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread.
+// Neither side ever blocks, a full queue simply refuses the push.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool TryPush(const T& value)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        _items[head & (Capacity - 1)] = value;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+            return false;
+
+        value = _items[tail & (Capacity - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot, the other side may move it at any time
+    size_t Size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+private:
+    // Kept on separate cache lines so the two threads don't false share
+    alignas(64) std::atomic<size_t> _head{ 0 };
+    alignas(64) std::atomic<size_t> _tail{ 0 };
+    std::array<T, Capacity> _items{};
+};
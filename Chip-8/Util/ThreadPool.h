@@ -0,0 +1,161 @@
+#pragma once
+
+#include "Types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque: it takes its own work from the
+// back and, once that runs dry, steals from the front of the others. Tasks submitted from
+// inside a task go to the submitting worker's own deque, the rest are dealt round robin.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(u32 threadCount = std::thread::hardware_concurrency())
+    {
+        threadCount = std::max(1u, threadCount);
+
+        for (u32 i = 0; i < threadCount; i++)
+            _workers.push_back(std::make_unique<Worker>());
+        for (u32 i = 0; i < threadCount; i++)
+            _threads.emplace_back(&ThreadPool::WorkerMain, this, i);
+    }
+
+    ~ThreadPool()
+    {
+        Wait();
+
+        {
+            std::lock_guard lock(_mutex);
+            _stopping = true;
+        }
+        _wake.notify_all();
+
+        for (std::thread& thread : _threads)
+            thread.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> task)
+    {
+        const u32 index = _currentPool == this ? _currentWorker : _nextWorker++ % _workers.size();
+
+        {
+            std::lock_guard lock(_workers[index]->mutex);
+            _workers[index]->tasks.push_back(std::move(task));
+        }
+
+        // Counted under the wake mutex so a worker about to sleep can't miss it
+        {
+            std::lock_guard lock(_mutex);
+            _queued++;
+            _pending++;
+        }
+        _wake.notify_one();
+    }
+
+    // Blocks until every submitted task has finished
+    void Wait()
+    {
+        std::unique_lock lock(_mutex);
+        _idle.wait(lock, [this] { return _pending == 0; });
+    }
+
+    u32 GetThreadCount() const { return (u32)_threads.size(); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool TryTake(u32 index, std::function<void()>& task)
+    {
+        // Own work newest first, it is the most likely to still be in cache
+        {
+            Worker& own = *_workers[index];
+            std::lock_guard lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < _workers.size(); i++)
+        {
+            Worker& victim = *_workers[(index + i) % _workers.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void WorkerMain(u32 index)
+    {
+        _currentPool = this;
+        _currentWorker = index;
+
+        std::function<void()> task;
+        while (true)
+        {
+            {
+                std::unique_lock lock(_mutex);
+                _wake.wait(lock, [this] { return _queued > 0 || _stopping; });
+                if (_queued == 0 && _stopping)
+                    return;
+            }
+
+            if (!TryTake(index, task))
+                continue; // Someone else got there first
+
+            {
+                std::lock_guard lock(_mutex);
+                _queued--;
+            }
+
+            task();
+            task = nullptr;
+
+            bool idle;
+            {
+                std::lock_guard lock(_mutex);
+                idle = --_pending == 0;
+            }
+            if (idle)
+                _idle.notify_all();
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<u32> _nextWorker{ 0 };
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    size_t _queued = 0; // Tasks sitting in any deque
+    size_t _pending = 0; // Tasks submitted and not yet finished
+    bool _stopping = false;
+
+    inline static thread_local ThreadPool* _currentPool = nullptr;
+    inline static thread_local u32 _currentWorker = 0;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Types.h"
+
+#include <array>
+#include <atomic>
+
+// Lock-free hand-off of the latest value from one producer thread to one consumer thread.
+// The producer fills Back() and publishes it; the consumer picks up the newest published
+// value with Update(). Neither side waits, and values the consumer never saw are skipped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side. Back() holds stale contents, so fill it completely before publishing.
+    T& Back() { return _slots[_back]; }
+    void Publish() { _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & INDEX; }
+
+    // Consumer side. Returns true when a newer value was swapped in.
+    bool Update()
+    {
+        if (!(_middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T& Front() const { return _slots[_front]; }
+
+private:
+    static constexpr u8 INDEX = 0x3;
+    static constexpr u8 FRESH = 0x4;
+
+    std::array<T, 3> _slots{};
+    std::atomic<u8> _middle{ 1 };
+    u8 _back = 0; // Producer only
+    u8 _front = 2; // Consumer only
+};
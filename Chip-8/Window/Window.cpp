@@ -1,12 +1,14 @@
 #include "Window.h"
 
-#include "Chip8.h"
+#include "EmuThread.h"
 
 #include <glad/glad.h>
 
-static void KeyCallback(GLFWwindow* window, i32 key, i32 scancode, i32 action, i32 mods);
 static u8 MapGlfwKeyToChip8(i32 key);
 
+// GLFW delivers every event on the main thread, and viewport windows have no Window to hold it
+static bool s_inputPending = false;
+
 Window::Window()
 {
     Init();
@@ -25,10 +27,24 @@ void Window::Clear()
     glClear(GL_COLOR_BUFFER_BIT);
 }
 
-void Window::Render()
+void Window::Present()
 {
     glfwSwapBuffers(_window);
-    glfwPollEvents();
+}
+
+bool Window::ConsumeInput()
+{
+    const bool input = s_inputPending;
+    s_inputPending = false;
+    return input;
+}
+
+void Window::WaitEvents(f64 timeout)
+{
+    if (timeout > 0.0)
+        glfwWaitEventsTimeout(timeout);
+    else
+        glfwPollEvents();
 }
 
 void Window::Init()
@@ -48,7 +64,16 @@ void Window::Init()
         // Fails
     }
 
+    glfwSetWindowUserPointer(_window, this);
     glfwSetKeyCallback(_window, KeyCallback);
+    glfwSetCharCallback(_window, CharCallback);
+    glfwSetMouseButtonCallback(_window, MouseButtonCallback);
+    glfwSetCursorPosCallback(_window, CursorPosCallback);
+    glfwSetCursorEnterCallback(_window, CursorEnterCallback);
+    glfwSetScrollCallback(_window, ScrollCallback);
+    glfwSetWindowFocusCallback(_window, FocusCallback);
+    glfwSetWindowRefreshCallback(_window, RedrawCallback);
+    glfwSetFramebufferSizeCallback(_window, FramebufferSizeCallback);
 
     glfwMakeContextCurrent(_window);
 
@@ -63,18 +88,35 @@ void Window::Init()
     glfwSwapInterval(1);
 }
 
-static void KeyCallback(GLFWwindow* window, i32 key, i32 scancode, i32 action, i32 mods)
+void Window::RedrawCallback(GLFWwindow* window)
 {
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->_redraw = true;
+}
+
+void Window::FramebufferSizeCallback(GLFWwindow* window, i32 width, i32 height)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->_redraw = true;
+}
+
+void Window::KeyCallback(GLFWwindow* window, i32 key, i32 scancode, i32 action, i32 mods)
+{
+    s_inputPending = true;
+
+    // Keys typed into a detached ImGui viewport are for ImGui alone
+    const Window* self = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    if (!self)
+        return;
+
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GLFW_TRUE);
 
-    Chip8* chip = static_cast<Chip8*>(glfwGetWindowUserPointer(window));
-    if (!chip)
+    EmuThread* emu = static_cast<EmuThread*>(self->GetUserPtr());
+    if (!emu)
         return;
 
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS)
     {
-        chip->Reset();
+        emu->Reset();
         return;
     }
 
@@ -83,9 +125,39 @@ static void KeyCallback(GLFWwindow* window, i32 key, i32 scancode, i32 action, i
         return;
 
     if (action == GLFW_PRESS || action == GLFW_REPEAT)
-        chip->GetCPU()->KeyDown(hex);
+        emu->KeyDown(hex);
     else if (action == GLFW_RELEASE)
-        chip->GetCPU()->KeyUp(hex);
+        emu->KeyUp(hex);
+}
+
+void Window::CharCallback(GLFWwindow* window, u32 codepoint)
+{
+    s_inputPending = true;
+}
+
+void Window::MouseButtonCallback(GLFWwindow* window, i32 button, i32 action, i32 mods)
+{
+    s_inputPending = true;
+}
+
+void Window::CursorPosCallback(GLFWwindow* window, f64 x, f64 y)
+{
+    s_inputPending = true;
+}
+
+void Window::CursorEnterCallback(GLFWwindow* window, i32 entered)
+{
+    s_inputPending = true;
+}
+
+void Window::ScrollCallback(GLFWwindow* window, f64 x, f64 y)
+{
+    s_inputPending = true;
+}
+
+void Window::FocusCallback(GLFWwindow* window, i32 focused)
+{
+    s_inputPending = true;
 }
 
 
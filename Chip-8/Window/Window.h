@@ -12,12 +12,24 @@ public:
     ~Window();
 
     void Clear();
-    void Render();
+    void Present();
+
+    // Sleeps until an event arrives or timeout seconds pass, only polls if timeout <= 0
+    void WaitEvents(f64 timeout);
+    // Ends a WaitEvents early, callable from any thread
+    static void Wake() { glfwPostEmptyEvent(); }
+
+    // True once after a resize or an expose, when the contents have to be drawn again
+    bool ConsumeRedraw() { const bool redraw = _redraw; _redraw = false; return redraw; }
+    // True once after mouse, keyboard or focus events in any GLFW window, ImGui's own
+    // viewport windows included. ImGui chains its callbacks to the ones set up here.
+    static bool ConsumeInput();
 
     bool ShouldClose() { return glfwWindowShouldClose(_window); }
 
-    void* GetUserPtr() const { return glfwGetWindowUserPointer(_window); }
-    void SetUserPtr(void* p) { glfwSetWindowUserPointer(_window, p); }
+    // The GLFW user pointer is the Window itself, this is the one for the key callback
+    void* GetUserPtr() const { return _userPtr; }
+    void SetUserPtr(void* p) { _userPtr = p; }
 
     GLFWwindow* GetHandle() { return _window; }
     i32 GetWidth() const { return _width; }
@@ -26,8 +38,20 @@ public:
 private:
     void Init();
 
+    static void KeyCallback(GLFWwindow* window, i32 key, i32 scancode, i32 action, i32 mods);
+    static void CharCallback(GLFWwindow* window, u32 codepoint);
+    static void MouseButtonCallback(GLFWwindow* window, i32 button, i32 action, i32 mods);
+    static void CursorPosCallback(GLFWwindow* window, f64 x, f64 y);
+    static void CursorEnterCallback(GLFWwindow* window, i32 entered);
+    static void ScrollCallback(GLFWwindow* window, f64 x, f64 y);
+    static void FocusCallback(GLFWwindow* window, i32 focused);
+    static void RedrawCallback(GLFWwindow* window);
+    static void FramebufferSizeCallback(GLFWwindow* window, i32 width, i32 height);
+
 private:
     GLFWwindow* _window = nullptr;
+    void* _userPtr = nullptr;
+    bool _redraw = true;
     i32 _width = 1280;
     i32 _height = 720;
 };
\ No newline at end of file
@@ -1,3 +1,97 @@
+project "Chip8Core"
+	kind "StaticLib"
+	language "C++"
+	cppdialect "c++20"
+	staticruntime "on"
+	targetdir (libout)
+	objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
+	
+	-- Everything needed to emulate, without any windowing or GL
+	files { "Chip8/**.h", "Chip8/**.cpp", "Audio/**.h", "Audio/**.cpp", "Util/**.h" }
+	removefiles { "Chip8/Texture.h" }
+	
+	-- Also linked into the chip8c shared library
+	pic "On"
+	
+	includedirs
+	{
+		"Chip8",
+		"Audio",
+		"Util"
+	}
+	
+	filter "configurations:Debug"
+		defines { "DEBUG" }
+		symbols "On"
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
+
+-- The C API, for embedding the core in other languages
+project "Chip8C"
+	kind "StaticLib"
+	language "C++"
+	cppdialect "c++20"
+	staticruntime "on"
+	targetdir (libout)
+	objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
+	
+	dependson { "Chip8Core" }
+	
+	files { "Api/**.h", "Api/**.cpp" }
+	
+	includedirs
+	{
+		"Api",
+		"Chip8",
+		"Util"
+	}
+	
+	filter "configurations:Debug"
+		defines { "DEBUG" }
+		symbols "On"
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
+
+-- Same API as Chip8C as a shared library, only the chip8_* functions are exported
+project "Chip8CShared"
+	kind "SharedLib"
+	language "C++"
+	cppdialect "c++20"
+	staticruntime "on"
+	targetname "chip8c"
+	targetdir ("%{wks.location}/bin/%{cfg.buildcfg}")
+	objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
+	
+	dependson { "Chip8Core" }
+	
+	files { "Api/**.h", "Api/**.cpp" }
+	
+	defines { "CHIP8C_BUILD_SHARED" }
+	visibility "Hidden"
+	
+	includedirs
+	{
+		"Api",
+		"Chip8",
+		"Util"
+	}
+	
+	libdirs { libout }
+	
+	links { "Chip8Core" }
+	
+	filter "configurations:Debug"
+		defines { "DEBUG" }
+		symbols "On"
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
+
 project "Chip8"
 	kind "ConsoleApp"
 	language "C++"
@@ -6,9 +100,10 @@ project "Chip8"
 	targetdir ("%{wks.location}/bin/%{cfg.buildcfg}")
     objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
 	
-	dependson { "glad", "glfw", "imgui" }
+	dependson { "glad", "glfw", "imgui", "Chip8Core" }
 	
 	files { "**.h", "**.cpp" }
+	removefiles { "Chip8/**.cpp", "Audio/**.cpp", "Api/**" }
 	
     includedirs
 	{
@@ -17,6 +112,7 @@ project "Chip8"
 		"%{wks.location}/Vendor/imgui",
 		
 		"Chip8",
+		"Audio",
 		"Entry",
 		"UI",
 		"Util",
@@ -30,18 +126,82 @@ project "Chip8"
 		"opengl32",
 		"glad",
 		"glfw",
-		"imgui"
+		"imgui",
+		"Chip8Core"
 	}
 	
 	vpaths
 	{
 		["Chip8"] = { "Chip8/**.h", "Chip8/**.cpp" },
+		["Audio"] = { "Audio/**.h", "Audio/**.cpp" },
 		["UI"] = { "UI/**.h", "UI/**.cpp" },
 		["Window"] = { "Window/**.h", "Window/**.cpp" },
 		["Util"] = { "Util/**.h", "Util/**.cpp" },
 		["Entry"] = { "Entry/**.h", "Entry/**.cpp" }
 	}
 	
+	filter "configurations:Debug"
+		defines { "DEBUG" }
+		symbols "On"
+		postbuildcommands { "{COPYDIR} Roms %{cfg.targetdir}/Roms" }
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
+		postbuildcommands { "{COPYDIR} Roms %{cfg.targetdir}/Roms" }
+
+project "Chip8AOT"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "c++20"
+	staticruntime "on"
+	targetdir ("%{wks.location}/bin/%{cfg.buildcfg}")
+    objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
+	
+	dependson { "glad", "glfw", "imgui", "Chip8Core", "Chip8Recompiler" }
+	
+	-- Same frontend as Chip8, plus the bundled ROMs recompiled ahead of time for DispatchMode::Static
+	files { "**.h", "**.cpp", "%{wks.location}/bin-int/Generated/StaticRoms.cpp" }
+	removefiles { "Chip8/**.cpp", "Audio/**.cpp", "Api/**" }
+	
+	prebuildcommands { '"%{wks.location}/bin/%{cfg.buildcfg}/Chip8Recompiler" -o "%{wks.location}/bin-int/Generated/StaticRoms.cpp" Roms' }
+	
+    includedirs
+	{
+		"%{wks.location}/Vendor/glfw/include",
+        "%{wks.location}/Vendor/glad/include",
+		"%{wks.location}/Vendor/imgui",
+		
+		"Chip8",
+		"Audio",
+		"Entry",
+		"UI",
+		"Util",
+		"Window"
+    }
+	
+	libdirs { libout } 
+	
+	links
+	{
+		"opengl32",
+		"glad",
+		"glfw",
+		"imgui",
+		"Chip8Core"
+	}
+	
+	vpaths
+	{
+		["Chip8"] = { "Chip8/**.h", "Chip8/**.cpp" },
+		["Audio"] = { "Audio/**.h", "Audio/**.cpp" },
+		["UI"] = { "UI/**.h", "UI/**.cpp" },
+		["Window"] = { "Window/**.h", "Window/**.cpp" },
+		["Util"] = { "Util/**.h", "Util/**.cpp" },
+		["Entry"] = { "Entry/**.h", "Entry/**.cpp" },
+		["Generated"] = { "%{wks.location}/bin-int/Generated/**.cpp" }
+	}
+	
 	filter "configurations:Debug"
 		defines { "DEBUG" }
 		symbols "On"
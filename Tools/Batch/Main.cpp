@@ -0,0 +1,314 @@
+#include "Chip8.h"
+#include "InputScript.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Runs a ROM corpus across all cores, one independent Chip8 per job, and streams a
+// CSV or JSON line per finished job. Jobs come from a directory of .ch8 files (each
+// picking up a <rom>.input script next to it, if there is one) or from a manifest
+// with one "<rom> [input script]" per line, paths relative to the manifest.
+//
+// Usage: Chip8Batch <roms directory | manifest> [-o report.csv|report.json] [-format csv|json]
+//                   [-frames N] [-cpf N] [-mode name] [-seed N] [-threads N]
+
+struct Job
+{
+    size_t index = 0;
+    std::filesystem::path rom;
+    std::filesystem::path script;
+};
+
+struct JobResult
+{
+    std::string error;
+    u64 cycles = 0;
+    u64 frames = 0;
+    f64 seconds = 0.0;
+    u64 screenHash = 0;
+    u32 unknownOpcodes = 0;
+    u16 pc = 0;
+};
+
+struct Settings
+{
+    u64 frames = 600;
+    i32 cyclesPerFrame = 0; // Chip8's default when 0
+    DispatchMode mode = CPU::HasThreadedDispatch() ? DispatchMode::Threaded : DispatchMode::Cached;
+    u32 seed = 1;
+};
+
+static bool CollectJobs(const std::filesystem::path& input, std::vector<Job>& jobs)
+{
+    if (std::filesystem::is_directory(input))
+    {
+        std::vector<std::filesystem::path> roms;
+        for (const auto& entry : std::filesystem::directory_iterator(input))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".ch8")
+                roms.push_back(entry.path());
+        }
+        std::sort(roms.begin(), roms.end());
+
+        for (const auto& rom : roms)
+        {
+            std::filesystem::path script = rom;
+            script += ".input";
+            jobs.push_back({ jobs.size(), rom, std::filesystem::exists(script) ? script : std::filesystem::path() });
+        }
+        return true;
+    }
+
+    std::ifstream manifest(input);
+    if (!manifest)
+        return false; // Fails
+
+    const std::filesystem::path base = input.parent_path();
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        std::istringstream fields(line);
+        std::string rom, script;
+        if (!(fields >> rom) || rom[0] == '#')
+            continue;
+        fields >> script;
+
+        jobs.push_back({ jobs.size(), base / rom, script.empty() ? std::filesystem::path() : base / script });
+    }
+    return true;
+}
+
+static JobResult RunJob(const Job& job, const Settings& settings)
+{
+    JobResult result;
+
+    InputScript script;
+    if (!job.script.empty() && !script.Load(job.script))
+    {
+        result.error = "bad input script";
+        return result;
+    }
+
+    Chip8 chip;
+    chip.SetSeed(settings.seed);
+    chip.LoadROM(job.rom.string());
+    if (!chip.GetROMSize())
+    {
+        result.error = "failed to load ROM";
+        return result;
+    }
+
+    CPU* cpu = chip.GetCPU();
+    cpu->SetDispatchMode(settings.mode);
+    if (settings.cyclesPerFrame)
+        chip.SetCyclesPerFrame(settings.cyclesPerFrame);
+
+    // A recorded script's own seed and cycles per frame win, or it wouldn't replay exactly
+    InputPlayer player(script);
+    player.Begin(chip);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    player.Run(chip, chip.GetCyclesForFrames(settings.frames));
+
+    result.seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    result.cycles = chip.GetTotalCycles();
+    result.frames = chip.GetTimerTicks();
+    result.screenHash = cpu->HashPlane();
+    result.unknownOpcodes = cpu->GetUnknownOpcodes();
+    result.pc = cpu->GetPC();
+
+    if (result.unknownOpcodes)
+        result.error = "unknown opcode";
+
+    return result;
+}
+
+// Serializes rows from every worker, in the order jobs finish
+class Report
+{
+public:
+    Report(FILE* file, bool json) : _file(file), _json(json)
+    {
+        if (_json)
+            fprintf(_file, "[\n");
+        else
+            fprintf(_file, "job,rom,script,status,error,cycles,frames,seconds,mips,screen_hash,unknown_opcodes,pc\n");
+    }
+
+    ~Report()
+    {
+        if (_json)
+            fprintf(_file, "\n]\n");
+        fflush(_file);
+    }
+
+    void Write(const Job& job, const JobResult& result)
+    {
+        const f64 mips = result.seconds > 0.0 ? result.cycles / result.seconds / 1e6 : 0.0;
+        const char* status = result.error.empty() ? "ok" : "error";
+
+        std::lock_guard lock(_mutex);
+        if (_json)
+        {
+            fprintf(_file, "%s  { \"job\": %zu, \"rom\": %s, \"script\": %s, \"status\": \"%s\", \"error\": %s, \"cycles\": %llu, \"frames\": %llu, "
+                "\"seconds\": %.6f, \"mips\": %.3f, \"screen_hash\": \"%016llx\", \"unknown_opcodes\": %u, \"pc\": %u }",
+                _rows ? ",\n" : "", job.index, JsonString(job.rom.string()).c_str(), JsonString(job.script.string()).c_str(), status,
+                JsonString(result.error).c_str(), (unsigned long long)result.cycles, (unsigned long long)result.frames, result.seconds, mips,
+                (unsigned long long)result.screenHash, result.unknownOpcodes, result.pc);
+        }
+        else
+        {
+            fprintf(_file, "%zu,%s,%s,%s,%s,%llu,%llu,%.6f,%.3f,%016llx,%u,0x%03X\n",
+                job.index, CsvString(job.rom.string()).c_str(), CsvString(job.script.string()).c_str(), status,
+                CsvString(result.error).c_str(), (unsigned long long)result.cycles, (unsigned long long)result.frames, result.seconds, mips,
+                (unsigned long long)result.screenHash, result.unknownOpcodes, result.pc);
+        }
+        fflush(_file);
+        _rows++;
+    }
+
+private:
+    static std::string JsonString(const std::string& text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    static std::string CsvString(const std::string& text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"')
+                out += '"';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+private:
+    FILE* _file;
+    bool _json;
+    std::mutex _mutex;
+    size_t _rows = 0;
+};
+
+static void PrintUsage()
+{
+    printf("Usage: Chip8Batch <roms directory | manifest> [-o report.csv|report.json] [-format csv|json]\n");
+    printf("                  [-frames N] [-cpf N] [-mode name] [-seed N] [-threads N]\n");
+    printf("Modes: switch, table, cached, block, jit, static, threaded\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path input;
+    std::filesystem::path output;
+    std::string format;
+    Settings settings;
+    u32 threads = std::thread::hardware_concurrency();
+
+    for (i32 i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(argv[i], "-o") == 0 && hasValue)
+            output = argv[++i];
+        else if (std::strcmp(argv[i], "-format") == 0 && hasValue)
+            format = argv[++i];
+        else if (std::strcmp(argv[i], "-frames") == 0 && hasValue)
+            settings.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-cpf") == 0 && hasValue)
+            settings.cyclesPerFrame = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "-seed") == 0 && hasValue)
+            settings.seed = (u32)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-threads") == 0 && hasValue)
+            threads = (u32)std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "-mode") == 0 && hasValue)
+        {
+            if (!DispatchModeFromName(argv[++i], settings.mode))
+            {
+                printf("Unknown dispatch mode: %s\n", argv[i]);
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-' && input.empty())
+            input = argv[i];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (input.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<Job> jobs;
+    if (!CollectJobs(input, jobs))
+    {
+        printf("Can't read %s\n", input.string().c_str());
+        return 1;
+    }
+
+    if (format.empty())
+        format = output.extension() == ".json" ? "json" : "csv";
+
+    FILE* file = output.empty() ? stdout : fopen(output.string().c_str(), "w");
+    if (!file)
+    {
+        printf("Can't write %s\n", output.string().c_str());
+        return 1;
+    }
+
+    std::atomic<u32> failures = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    {
+        Report report(file, format == "json");
+        ThreadPool pool(threads);
+
+        for (const Job& job : jobs)
+        {
+            pool.Submit([&, job]
+                {
+                    const JobResult result = RunJob(job, settings);
+                    failures += !result.error.empty();
+                    report.Write(job, result);
+                });
+        }
+
+        pool.Wait();
+    }
+
+    const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+    if (file != stdout)
+    {
+        fclose(file);
+        printf("%zu jobs on %u threads in %.3f s, %u with errors\n", jobs.size(), threads, seconds, failures.load());
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+project "Chip8Batch"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "c++20"
+	staticruntime "on"
+	targetdir ("%{wks.location}/bin/%{cfg.buildcfg}")
+	objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
+	
+	-- Regression runs over a ROM corpus, no window or GL needed
+	dependson { "Chip8Core" }
+	
+	files { "**.h", "**.cpp" }
+	
+	includedirs
+	{
+		"%{wks.location}/Chip-8/Chip8",
+		"%{wks.location}/Chip-8/Util"
+	}
+	
+	libdirs { libout }
+	
+	links { "Chip8Core" }
+	
+	filter "system:linux"
+		links { "pthread" }
+	
+	filter "configurations:Debug"
+		defines { "DEBUG" }
+		symbols "On"
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
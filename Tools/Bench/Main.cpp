@@ -0,0 +1,370 @@
+#include "Chip8.h"
+#include "BatchCPU.h"
+#include "PixelExpander.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Runs every ROM in a directory under each dispatch mode and reports instructions per second.
+// Every mode is also checked against the Switch interpreter, which is the reference semantics.
+// The framebuffer expansion kernels are then timed and checked against the scalar one,
+// and BatchCPU is run against one Chip8 per lane and compared lane by lane.
+//
+// Usage: Chip8Bench [roms directory] [-frames N] [-cpf N] [-lanes N]
+
+struct Result
+{
+    f64 ips = 0.0;
+    u64 hash = 0;
+    f64 halted = 0.0; // Share of the cycles spent halted on FX0A, which aren't executed
+};
+
+static u64 HashState(const CPU* cpu)
+{
+    u64 hash = 1469598103934665603ull;
+    auto mix = [&](u64 value)
+        {
+            hash ^= value;
+            hash *= 1099511628211ull;
+        };
+
+    const u64* plane = cpu->GetPlane();
+    for (i32 y = 0; y < CPU::SCREEN_HEIGHT; y++)
+        mix(plane[y]);
+
+    for (u8 r = 0; r < 16; r++)
+        mix(cpu->GetVRegister(r));
+
+    mix(cpu->GetIndex());
+    mix(cpu->GetPC());
+    mix(cpu->GetSP());
+    mix(cpu->GetDelayTimer());
+    mix(cpu->GetSoundTimer());
+
+    // Memory and the return addresses catch a missed code invalidation or a bad FX33/FX55 write
+    for (const u8 byte : cpu->GetMemoryArray())
+        mix(byte);
+
+    const u16 depth = std::min<u16>(cpu->GetSP(), 16);
+    for (u16 i = 0; i < depth; i++)
+        mix(cpu->GetStack()[i]);
+
+    return hash;
+}
+
+static void BenchExpand(i32 width, i32 height, i32 iterations)
+{
+    // Any bit pattern works, an LCG keeps it the same from run to run
+    std::vector<u64> plane(width / 64 * height);
+    u64 seed = 1;
+    for (u64& word : plane)
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        word = seed;
+    }
+
+    const Palette palette{ 0xFF40C0FF, 0xFF201000 };
+    std::vector<u32> reference(width * height);
+    std::vector<u32> pixels(width * height);
+    PixelExpander::Expand(plane.data(), width, 0, height, palette, reference.data(), ExpandKernel::Scalar);
+
+    const struct { const char* name; ExpandKernel kernel; } kernels[] =
+    {
+        { "Scalar", ExpandKernel::Scalar },
+        { "SSE2", ExpandKernel::SSE2 },
+        { "AVX2", ExpandKernel::AVX2 }
+    };
+
+    char size[16];
+    snprintf(size, sizeof(size), "%dx%d", width, height);
+    printf("%-7s", size);
+    for (const auto& kernel : kernels)
+    {
+        if (!PixelExpander::IsSupported(kernel.kernel))
+        {
+            printf("%10s", "-");
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for (i32 i = 0; i < iterations; i++)
+            PixelExpander::Expand(plane.data(), width, 0, height, palette, pixels.data(), kernel.kernel);
+        const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+        const bool mismatch = pixels != reference;
+        printf("%9.1f%s", seconds > 0.0 ? (f64)width * height * iterations / seconds / 1e6 : 0.0, mismatch ? "!" : " ");
+    }
+    printf("\n");
+}
+
+// Lane l presses key l % 16 on and off at its own phase, so the lanes diverge
+static bool LaneKeyDown(u32 lane, i32 frame)
+{
+    return (frame / 8 + lane) % 4 == 0;
+}
+
+struct BatchResult
+{
+    f64 batchIps = 0.0;
+    f64 scalarIps = 0.0;
+    f64 uniform = 0.0;
+    u32 mismatches = 0;
+};
+
+static BatchResult RunBatch(const std::filesystem::path& romPath, u32 lanes, i32 frames, i32 cyclesPerFrame)
+{
+    BatchResult result;
+
+    std::vector<std::unique_ptr<Chip8>> chips;
+    for (u32 lane = 0; lane < lanes; lane++)
+    {
+        chips.push_back(std::make_unique<Chip8>());
+        chips.back()->LoadROM(romPath.string());
+        chips.back()->GetCPU()->SeedRandom(lane);
+        chips.back()->SetCyclesPerFrame(cyclesPerFrame);
+        chips.back()->SetIdleSkip(false);
+        chips.back()->SetPaused(false);
+    }
+
+    std::vector<u8> rom(chips[0]->GetROMSize());
+    const CPUState& boot = chips[0]->GetCPU()->GetState();
+    std::copy(boot._memory.begin() + 0x200, boot._memory.begin() + 0x200 + rom.size(), rom.begin());
+
+    BatchCPU batch(lanes);
+    batch.Reset(rom.data(), rom.size());
+    for (u32 lane = 0; lane < lanes; lane++)
+        batch.SeedRandom(lane, lane);
+
+    auto start = std::chrono::steady_clock::now();
+    for (i32 frame = 0; frame < frames; frame++)
+    {
+        for (u32 lane = 0; lane < lanes; lane++)
+        {
+            if (LaneKeyDown(lane, frame))
+                batch.KeyDown(lane, lane % 16);
+            else
+                batch.KeyUp(lane, lane % 16);
+        }
+        batch.RunFrame(cyclesPerFrame);
+    }
+    const f64 batchSeconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (u32 lane = 0; lane < lanes; lane++)
+    {
+        CPU* cpu = chips[lane]->GetCPU();
+        for (i32 frame = 0; frame < frames; frame++)
+        {
+            if (LaneKeyDown(lane, frame))
+                cpu->KeyDown(lane % 16);
+            else
+                cpu->KeyUp(lane % 16);
+            chips[lane]->Cycle();
+        }
+    }
+    const f64 scalarSeconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    // Lanes halted on FX0A only count the cycles, BatchCPU still steps them
+    u64 scalarInstructions = 0;
+    for (u32 lane = 0; lane < lanes; lane++)
+        scalarInstructions += chips[lane]->GetTotalCycles() - chips[lane]->GetIdleCycles();
+
+    CPUState state;
+    for (u32 lane = 0; lane < lanes; lane++)
+    {
+        batch.GetState(lane, state);
+        const CPUState& expected = chips[lane]->GetCPU()->GetState();
+
+        const bool same = state._memory == expected._memory && state._registers == expected._registers &&
+            state._key == expected._key && state._stack == expected._stack && state._screen == expected._screen &&
+            state._opcode == expected._opcode && state._index == expected._index && state._pc == expected._pc &&
+            state._sp == expected._sp && state._delayTimer == expected._delayTimer && state._soundTimer == expected._soundTimer;
+        result.mismatches += !same;
+    }
+
+    const f64 instructions = (f64)lanes * frames * cyclesPerFrame;
+    result.batchIps = batchSeconds > 0.0 ? instructions / batchSeconds : 0.0;
+    result.scalarIps = scalarSeconds > 0.0 ? scalarInstructions / scalarSeconds : 0.0;
+    result.uniform = batch.GetSteps() ? (f64)batch.GetUniformSteps() / batch.GetSteps() : 0.0;
+    return result;
+}
+
+static Result Run(const std::filesystem::path& rom, DispatchMode mode, i32 frames, i32 cyclesPerFrame)
+{
+    // Idle loops would be skipped rather than dispatched, which is the thing being measured.
+    // A halt on FX0A can't be turned off, its cycles are left out of the rate instead.
+    Chip8 chip;
+    chip.SetIdleSkip(false);
+    chip.LoadROM(rom.string());
+    chip.GetCPU()->SeedRandom(1);
+    chip.GetCPU()->SetDispatchMode(mode);
+    chip.SetCyclesPerFrame(cyclesPerFrame);
+    chip.SetPaused(false);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (i32 i = 0; i < frames; i++)
+        chip.Cycle();
+
+    const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    const u64 cycles = chip.GetTotalCycles();
+    const u64 executed = cycles - chip.GetIdleCycles();
+
+    Result result;
+    result.ips = seconds > 0.0 ? executed / seconds : 0.0;
+    result.hash = HashState(chip.GetCPU());
+    result.halted = cycles ? (f64)(cycles - executed) / cycles : 0.0;
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path romDir = "Roms";
+    i32 frames = 600;
+    i32 cyclesPerFrame = 1000;
+    u32 lanes = 64;
+
+    for (i32 i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            frames = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "-lanes") == 0 && i + 1 < argc)
+            lanes = (u32)std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "-cpf") == 0 && i + 1 < argc)
+            cyclesPerFrame = std::max(1, std::atoi(argv[++i]));
+        else
+            romDir = argv[i];
+    }
+
+    if (!std::filesystem::is_directory(romDir))
+    {
+        printf("ROM directory not found: %s\n", romDir.string().c_str());
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> roms;
+    for (const auto& entry : std::filesystem::directory_iterator(romDir))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".ch8")
+            roms.push_back(entry.path());
+    }
+    std::sort(roms.begin(), roms.end());
+
+    struct Mode
+    {
+        const char* name;
+        DispatchMode mode;
+        bool available;
+    };
+
+    const Mode modes[] =
+    {
+        { "Switch", DispatchMode::Switch, true },
+        { "Table", DispatchMode::Table, true },
+        { "Cached", DispatchMode::Cached, true },
+        { "Block", DispatchMode::Block, true },
+        { "JIT", DispatchMode::Jit, Jit::IsSupported() },
+        { "Static", DispatchMode::Static, true },
+        { "Threaded", DispatchMode::Threaded, CPU::HasThreadedDispatch() }
+    };
+
+    printf("%d frames at %d cycles/frame, MIPS per dispatch mode ('!' = state differs from Switch)\n", frames, cyclesPerFrame);
+    printf("ROMs that halt on FX0A waiting for a key are rated on the cycles they ran, and left out of the average\n\n");
+    printf("%-40s", "ROM");
+    for (const Mode& mode : modes)
+        printf("%10s", mode.name);
+    printf("\n");
+
+    std::vector<f64> totals(std::size(modes), 0.0);
+    size_t averaged = 0;
+    i32 mismatches = 0;
+
+    for (const auto& rom : roms)
+    {
+        std::string name = rom.filename().string();
+        if (name.size() > 38)
+            name = name.substr(0, 35) + "...";
+
+        printf("%-40s", name.c_str());
+
+        u64 reference = 0;
+        f64 halted = 0.0;
+        std::vector<f64> rates(std::size(modes), 0.0);
+        for (size_t m = 0; m < std::size(modes); m++)
+        {
+            if (!modes[m].available)
+            {
+                printf("%10s", "-");
+                continue;
+            }
+
+            const Result result = Run(rom, modes[m].mode, frames, cyclesPerFrame);
+            if (m == 0)
+                reference = result.hash;
+
+            const bool mismatch = result.hash != reference;
+            mismatches += mismatch;
+            rates[m] = result.ips;
+            halted = std::max(halted, result.halted);
+
+            printf("%9.2f%s", result.ips / 1e6, mismatch ? "!" : " ");
+        }
+
+        // A few instructions spread over the whole run say nothing about the engine
+        if (halted > 0.0)
+            printf("  halted %.1f%%", halted * 100.0);
+        else
+        {
+            for (size_t m = 0; m < std::size(modes); m++)
+                totals[m] += rates[m];
+            averaged++;
+        }
+        printf("\n");
+    }
+
+    printf("%-40s", "Average");
+    for (size_t m = 0; m < std::size(modes); m++)
+    {
+        if (modes[m].available && averaged)
+            printf("%9.2f ", totals[m] / averaged / 1e6);
+        else
+            printf("%10s", "-");
+    }
+    printf("\n");
+
+    if (mismatches)
+        printf("\n%d runs differ from the Switch interpreter\n", mismatches);
+    const i32 modeMismatches = mismatches;
+
+    printf("\nFramebuffer expansion, Mpixels/s ('!' = output differs from Scalar)\n\n");
+    printf("%-7s%10s%10s%10s\n", "Size", "Scalar", "SSE2", "AVX2");
+    BenchExpand(64, 32, 200000);
+    BenchExpand(128, 64, 50000);
+
+    printf("\nBatchCPU, %u lanes against one Chip8 per lane, MIPS summed over lanes\n\n", lanes);
+    printf("%-40s%10s%10s%10s%10s\n", "ROM", "Batch", "Scalar", "Uniform", "Differ");
+    for (const auto& rom : roms)
+    {
+        std::string name = rom.filename().string();
+        if (name.size() > 38)
+            name = name.substr(0, 35) + "...";
+
+        const BatchResult result = RunBatch(rom, lanes, frames, cyclesPerFrame);
+        mismatches += result.mismatches;
+
+        printf("%-40s%10.2f%10.2f%9.1f%%%10u\n", name.c_str(), result.batchIps / 1e6, result.scalarIps / 1e6, result.uniform * 100.0, result.mismatches);
+    }
+
+    if (mismatches > modeMismatches)
+        printf("\n%d lanes differ from their Chip8\n", mismatches - modeMismatches);
+
+    return mismatches ? 1 : 0;
+}
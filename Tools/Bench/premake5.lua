@@ -0,0 +1,34 @@
+project "Chip8Bench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "c++20"
+	staticruntime "on"
+	targetdir ("%{wks.location}/bin/%{cfg.buildcfg}")
+	objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
+	
+	dependson { "Chip8Core", "Chip8Recompiler" }
+	
+	-- The bundled ROMs are recompiled so DispatchMode::Static has something to run
+	files { "**.h", "**.cpp", "%{wks.location}/bin-int/Generated/Bench/StaticRoms.cpp" }
+	
+	prebuildcommands { '"%{wks.location}/bin/%{cfg.buildcfg}/Chip8Recompiler" -o "%{wks.location}/bin-int/Generated/Bench/StaticRoms.cpp" "%{wks.location}/Chip-8/Roms"' }
+	
+	includedirs
+	{
+		"%{wks.location}/Chip-8/Chip8",
+		"%{wks.location}/Chip-8/Util"
+	}
+	
+	libdirs { libout }
+	
+	links { "Chip8Core" }
+	
+	debugargs { "%{wks.location}/Chip-8/Roms" }
+	
+	filter "configurations:Debug"
+		defines { "DEBUG" }
+		symbols "On"
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
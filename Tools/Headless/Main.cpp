@@ -0,0 +1,217 @@
+#include "Chip8.h"
+#include "InputScript.h"
+#include "PixelExpander.h"
+#include "WavAudioSink.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Runs a ROM without a window as fast as the chosen engine allows, then reports
+// throughput and a hash of the final framebuffer. Everything is seeded, so the
+// same arguments always give the same hash.
+//
+// Usage: Chip8Headless <rom> [-frames N | -cycles N] [-cpf N] [-mode name] [-seed N]
+//                            [-input script] [-png file] [-png-every N] [-scale N] [-wav file]
+//                            [-no-idle-skip]
+//
+// An input script replays its key presses, and its seed and cycles per frame win over the arguments.
+
+struct Options
+{
+    std::filesystem::path rom;
+    u64 frames = 600;
+    u64 cycles = 0; // Overrides frames when set
+    i32 cyclesPerFrame = 0; // Chip8's default when 0
+    DispatchMode mode = CPU::HasThreadedDispatch() ? DispatchMode::Threaded : DispatchMode::Cached;
+    u32 seed = 1;
+    std::filesystem::path input;
+
+    std::filesystem::path png;
+    u64 pngEvery = 0;
+    i32 scale = 1;
+
+    std::filesystem::path wav;
+
+    bool idleSkip = true;
+};
+
+static bool WritePng(const std::filesystem::path& path, const CPU* cpu, i32 scale)
+{
+    // Opaque black and white, the default palette leaves the background transparent
+    const Palette palette{ 0xFFFFFFFF, 0xFF000000 };
+
+    std::vector<u32> pixels(CPU::SCREEN_WIDTH * CPU::SCREEN_HEIGHT);
+    PixelExpander::Expand(cpu->GetPlane(), CPU::SCREEN_WIDTH, 0, CPU::SCREEN_HEIGHT, palette, pixels.data());
+
+    const i32 width = CPU::SCREEN_WIDTH * scale;
+    const i32 height = CPU::SCREEN_HEIGHT * scale;
+
+    std::vector<u32> scaled(width * height);
+    for (i32 y = 0; y < height; y++)
+    {
+        for (i32 x = 0; x < width; x++)
+            scaled[y * width + x] = pixels[(y / scale) * CPU::SCREEN_WIDTH + x / scale];
+    }
+
+    return stbi_write_png(path.string().c_str(), width, height, 4, scaled.data(), width * sizeof(u32)) != 0;
+}
+
+static std::filesystem::path NumberedPath(const std::filesystem::path& path, u64 frame)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_%06llu", (unsigned long long)frame);
+
+    std::filesystem::path numbered = path;
+    numbered.replace_filename(path.stem().string() + suffix + path.extension().string());
+    return numbered;
+}
+
+static void PrintUsage()
+{
+    printf("Usage: Chip8Headless <rom> [-frames N | -cycles N] [-cpf N] [-mode name] [-seed N]\n");
+    printf("                           [-input script] [-png file] [-png-every N] [-scale N] [-wav file]\n");
+    printf("                           [-no-idle-skip]\n");
+    printf("Modes: switch, table, cached, block, jit, static, threaded\n");
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (i32 i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(argv[i], "-frames") == 0 && hasValue)
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-cycles") == 0 && hasValue)
+            options.cycles = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-cpf") == 0 && hasValue)
+            options.cyclesPerFrame = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "-seed") == 0 && hasValue)
+            options.seed = (u32)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-input") == 0 && hasValue)
+            options.input = argv[++i];
+        else if (std::strcmp(argv[i], "-png") == 0 && hasValue)
+            options.png = argv[++i];
+        else if (std::strcmp(argv[i], "-png-every") == 0 && hasValue)
+            options.pngEvery = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-scale") == 0 && hasValue)
+            options.scale = std::clamp(std::atoi(argv[++i]), 1, 64);
+        else if (std::strcmp(argv[i], "-wav") == 0 && hasValue)
+            options.wav = argv[++i];
+        else if (std::strcmp(argv[i], "-no-idle-skip") == 0)
+            options.idleSkip = false;
+        else if (std::strcmp(argv[i], "-mode") == 0 && hasValue)
+        {
+            if (!DispatchModeFromName(argv[++i], options.mode))
+            {
+                printf("Unknown dispatch mode: %s\n", argv[i]);
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-' && options.rom.empty())
+            options.rom = argv[i];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (options.rom.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    InputScript script;
+    if (!options.input.empty() && !script.Load(options.input))
+    {
+        printf("Failed to load input script: %s\n", options.input.string().c_str());
+        return 1;
+    }
+
+    Chip8 chip;
+    chip.SetSeed(options.seed);
+    chip.SetIdleSkip(options.idleSkip);
+    chip.LoadROM(options.rom.string());
+    if (!chip.GetROMSize())
+    {
+        printf("Failed to load ROM: %s\n", options.rom.string().c_str());
+        return 1;
+    }
+
+    CPU* cpu = chip.GetCPU();
+    cpu->SetDispatchMode(options.mode);
+    if (options.cyclesPerFrame)
+        chip.SetCyclesPerFrame(options.cyclesPerFrame);
+
+    InputPlayer player(script);
+    player.Begin(chip);
+
+    std::unique_ptr<WavAudioSink> wav;
+    if (!options.wav.empty())
+    {
+        wav = std::make_unique<WavAudioSink>(options.wav.string());
+        chip.SetAudioSink(wav.get());
+    }
+
+    // Rounded down when a script runs at an instructions per second rate that isn't a multiple of 60
+    const u64 cyclesPerFrame = chip.GetCyclesForFrames(1);
+    const u64 total = options.cycles ? options.cycles : chip.GetCyclesForFrames(options.frames);
+
+    // Frame by frame only when something has to happen between frames
+    const u64 chunk = options.pngEvery ? cyclesPerFrame : std::max<u64>(cyclesPerFrame, 1u << 24);
+
+    f64 seconds = 0.0;
+    u64 done = 0;
+    u64 frame = 0;
+    while (done < total)
+    {
+        const u32 count = (u32)std::min(chunk, total - done);
+
+        const auto start = std::chrono::steady_clock::now();
+        player.Run(chip, count);
+        seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+        done += count;
+        frame = done / cyclesPerFrame;
+
+        if (options.pngEvery && !options.png.empty() && frame % options.pngEvery == 0)
+            WritePng(NumberedPath(options.png, frame), cpu, options.scale);
+    }
+
+    printf("ROM:        %s (%zu bytes)\n", options.rom.filename().string().c_str(), chip.GetROMSize());
+    printf("Cycles:     %llu (%llu frames at %llu cycles/frame)\n", (unsigned long long)done, (unsigned long long)frame, (unsigned long long)cyclesPerFrame);
+    printf("Emulated:   %.2f s\n", chip.GetEmulatedSeconds());
+    printf("Idle:       %.1f%% of cycles skipped\n", done ? 100.0 * chip.GetIdleCycles() / done : 0.0);
+    printf("Wall:       %.4f s\n", seconds);
+    printf("Throughput: %.2f MIPS, %.0f frames/s\n", seconds > 0.0 ? done / seconds / 1e6 : 0.0, seconds > 0.0 ? frame / seconds : 0.0);
+    printf("Screen:     %016llx\n", (unsigned long long)cpu->HashPlane());
+
+    if (!options.png.empty() && !WritePng(options.png, cpu, options.scale))
+    {
+        printf("Failed to write %s\n", options.png.string().c_str());
+        return 1;
+    }
+
+    if (wav && !wav->Close())
+    {
+        printf("Failed to write %s\n", options.wav.string().c_str());
+        return 1;
+    }
+
+    return 0;
+}
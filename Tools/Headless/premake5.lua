@@ -0,0 +1,32 @@
+project "Chip8Headless"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "c++20"
+	staticruntime "on"
+	targetdir ("%{wks.location}/bin/%{cfg.buildcfg}")
+	objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
+	
+	-- No window, GL or ImGui, so it runs on build machines without a GPU
+	dependson { "Chip8Core" }
+	
+	files { "**.h", "**.cpp" }
+	
+	includedirs
+	{
+		"%{wks.location}/Chip-8/Chip8",
+		"%{wks.location}/Chip-8/Audio",
+		"%{wks.location}/Chip-8/Util",
+		"%{wks.location}/Vendor/glfw/deps"
+	}
+	
+	libdirs { libout }
+	
+	links { "Chip8Core" }
+	
+	filter "configurations:Debug"
+		defines { "DEBUG" }
+		symbols "On"
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
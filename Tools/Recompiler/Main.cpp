@@ -0,0 +1,84 @@
+#include "Recompiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// Usage: Chip8Recompiler -o <output.cpp> <rom or directory>...
+int main(int argc, char** argv)
+{
+    std::filesystem::path output;
+    std::vector<std::filesystem::path> inputs;
+
+    for (i32 i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else
+            inputs.push_back(argv[i]);
+    }
+
+    if (output.empty() || inputs.empty())
+    {
+        printf("Usage: Chip8Recompiler -o <output.cpp> <rom or directory>...\n");
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> roms;
+    for (const auto& input : inputs)
+    {
+        if (std::filesystem::is_directory(input))
+        {
+            for (const auto& entry : std::filesystem::directory_iterator(input))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".ch8")
+                    roms.push_back(entry.path());
+            }
+        }
+        else
+            roms.push_back(input);
+    }
+
+    // Stable output regardless of directory iteration order
+    std::sort(roms.begin(), roms.end());
+
+    Recompiler recompiler;
+    for (const auto& rom : roms)
+    {
+        if (!recompiler.AddRom(rom))
+            printf("Skipping %s\n", rom.string().c_str());
+    }
+
+    const std::string source = recompiler.Generate();
+
+    // Leave the file alone when nothing changed so the target doesn't rebuild every time
+    std::ifstream existing(output, std::ios::binary);
+    if (existing)
+    {
+        std::stringstream current;
+        current << existing.rdbuf();
+        if (current.str() == source)
+            return 0;
+    }
+    existing.close();
+
+    if (output.has_parent_path())
+        std::filesystem::create_directories(output.parent_path());
+
+    std::ofstream file(output, std::ios::binary);
+    if (!file)
+    {
+        printf("Failed to write %s\n", output.string().c_str());
+        return 1;
+    }
+
+    file << source;
+
+    printf("Recompiled %zu ROMs into %zu blocks (%zu instructions)\n",
+        recompiler.GetRomCount(), recompiler.GetBlockCount(), recompiler.GetInstructionCount());
+
+    return 0;
+}
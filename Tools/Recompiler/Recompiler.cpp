@@ -0,0 +1,329 @@
+#include "Recompiler.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <fstream>
+#include <set>
+
+namespace
+{
+    void Append(std::string& out, const char* format, ...)
+    {
+        char buf[512];
+
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+
+        out += buf;
+    }
+
+    std::string EscapeString(const std::string& text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+bool Recompiler::AddRom(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    Rom rom;
+    rom.name = path.filename().string();
+    rom.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if (rom.data.empty() || START_ADDRESS + rom.data.size() > 4096)
+        return false;
+
+    Analyze(rom);
+    _roms.push_back(std::move(rom));
+
+    return true;
+}
+
+size_t Recompiler::GetBlockCount() const
+{
+    size_t count = 0;
+    for (const Rom& rom : _roms)
+        count += rom.blocks.size();
+    return count;
+}
+
+size_t Recompiler::GetInstructionCount() const
+{
+    size_t count = 0;
+    for (const Rom& rom : _roms)
+        for (const auto& [addr, ops] : rom.blocks)
+            count += ops.size();
+    return count;
+}
+
+bool Recompiler::IsSupported(u16 opcode)
+{
+    // Anything touching timers, the screen, the RNG or writing memory stays with the interpreter
+    switch (opcode & 0xF000)
+    {
+    case 0x0000: return opcode != 0x00E0;
+    case 0x1000:
+    case 0x2000:
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x6000:
+    case 0x7000:
+    case 0x9000:
+    case 0xA000:
+    case 0xB000:
+        return true;
+    case 0x8000:
+    {
+        const u8 n = opcode & 0x000F;
+        return n <= 0x7 || n == 0xE;
+    }
+    case 0xE000:
+    {
+        const u8 nn = opcode & 0x00FF;
+        return nn == 0x9E || nn == 0xA1;
+    }
+    case 0xF000:
+    {
+        const u8 nn = opcode & 0x00FF;
+        return nn == 0x1E || nn == 0x65;
+    }
+    }
+
+    return false;
+}
+
+bool Recompiler::EndsBlock(u16 opcode)
+{
+    switch (opcode & 0xF000)
+    {
+    case 0x0000: return opcode == 0x00EE;
+    case 0x1000:
+    case 0x2000:
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x9000:
+    case 0xB000:
+    case 0xE000:
+        return true;
+    }
+
+    return false;
+}
+
+void Recompiler::Analyze(Rom& rom) const
+{
+    const u16 end = (u16)(START_ADDRESS + rom.data.size());
+    auto inRom = [&](u16 addr) { return addr >= START_ADDRESS && addr + 1 < end; };
+    auto opcodeAt = [&](u16 addr) -> u16 { return rom.data[addr - START_ADDRESS] << 8 | rom.data[addr - START_ADDRESS + 1]; };
+
+    std::vector<bool> reachable(4096, false);
+    std::set<u16> leaders{ START_ADDRESS };
+    std::vector<u16> work{ START_ADDRESS };
+
+    while (!work.empty())
+    {
+        const u16 addr = work.back();
+        work.pop_back();
+
+        if (!inRom(addr) || reachable[addr])
+            continue;
+
+        reachable[addr] = true;
+
+        const u16 op = opcodeAt(addr);
+        const u16 nnn = op & 0x0FFF;
+
+        auto branch = [&](u16 target)
+            {
+                leaders.insert(target);
+                work.push_back(target);
+            };
+
+        switch (op & 0xF000)
+        {
+        case 0x1000:
+            branch(nnn);
+            break;
+        case 0x2000:
+            branch(nnn);
+            branch(addr + 2);
+            break;
+        case 0xB000:
+            break; // Indirect, resolved at runtime
+        default:
+            if (op == 0x00EE)
+                break;
+
+            if (EndsBlock(op))
+            {
+                branch(addr + 2);
+                branch(addr + 4);
+            }
+            else if (!IsSupported(op))
+                branch(addr + 2);
+            else
+                work.push_back(addr + 2);
+            break;
+        }
+    }
+
+    for (u16 leader : leaders)
+    {
+        if (!inRom(leader) || !reachable[leader])
+            continue;
+
+        std::vector<u16> ops;
+        for (u16 addr = leader; inRom(addr) && ops.size() < MAX_BLOCK_LENGTH; addr += 2)
+        {
+            const u16 op = opcodeAt(addr);
+            if (!IsSupported(op))
+                break;
+
+            ops.push_back(op);
+
+            if (EndsBlock(op))
+                break;
+        }
+
+        if (!ops.empty())
+            rom.blocks[leader] = std::move(ops);
+    }
+}
+
+std::string Recompiler::Generate() const
+{
+    std::string out;
+    out += "// Generated by Chip8Recompiler, do not edit.\n";
+    out += "\n";
+    out += "#include \"StaticProgram.h\"\n";
+    out += "\n";
+    out += "#include <iterator>\n";
+
+    for (size_t i = 0; i < _roms.size(); i++)
+        GenerateRom(out, _roms[i], i);
+
+    return out;
+}
+
+void Recompiler::GenerateRom(std::string& out, const Rom& rom, size_t index) const
+{
+    Append(out, "\n// %s\n", rom.name.c_str());
+    Append(out, "namespace Rom%zu\n{\n", index);
+
+    out += "    const u8 ROM[] =\n    {";
+    for (size_t i = 0; i < rom.data.size(); i++)
+        Append(out, "%s0x%02X,", i % 16 ? " " : "\n        ", rom.data[i]);
+    out += "\n    };\n";
+
+    for (const auto& [start, ops] : rom.blocks)
+    {
+        Append(out, "\n    void Block_%03X(CPUState& s)\n    {\n", start);
+
+        u16 addr = start;
+        for (u16 op : ops)
+        {
+            GenerateInstruction(out, addr, op);
+            addr += 2;
+        }
+
+        Append(out, "        s._opcode = 0x%04X;\n", ops.back());
+        if (!EndsBlock(ops.back()))
+            Append(out, "        s._pc = 0x%03X;\n", addr);
+
+        out += "    }\n";
+    }
+
+    out += "\n    const StaticBlock BLOCKS[] =\n    {\n";
+    for (const auto& [start, ops] : rom.blocks)
+        Append(out, "        { 0x%03X, %zu, &Block_%03X },\n", start, ops.size(), start);
+    out += "    };\n";
+
+    Append(out, "\n    const StaticProgram PROGRAM{ \"%s\", ROM, sizeof(ROM), BLOCKS, std::size(BLOCKS) };\n", EscapeString(rom.name).c_str());
+    out += "    const bool REGISTERED = StaticProgram::Register(&PROGRAM);\n";
+    out += "}\n";
+}
+
+void Recompiler::GenerateInstruction(std::string& out, u16 addr, u16 op) const
+{
+    const u16 nnn = op & 0x0FFF;
+    const u8 nn = op & 0x00FF;
+    const u8 x = (op & 0x0F00) >> 8;
+    const u8 y = (op & 0x00F0) >> 4;
+    const u16 next = addr + 2;
+    const u16 skip = addr + 4;
+
+    Append(out, "        // 0x%03X: %04X\n", addr, op);
+
+    switch (op & 0xF000)
+    {
+    case 0x0000:
+        if (op == 0x00EE)
+            out += "        s._sp--; s._pc = s._stack[s._sp];\n";
+        break;
+    case 0x1000: Append(out, "        s._pc = 0x%03X;\n", nnn); break;
+    case 0x2000: Append(out, "        s._stack[s._sp] = 0x%03X; s._sp++; s._pc = 0x%03X;\n", next, nnn); break;
+    case 0x3000: Append(out, "        s._pc = s._registers[0x%X] == 0x%02X ? 0x%03X : 0x%03X;\n", x, nn, skip, next); break;
+    case 0x4000: Append(out, "        s._pc = s._registers[0x%X] != 0x%02X ? 0x%03X : 0x%03X;\n", x, nn, skip, next); break;
+    case 0x5000: Append(out, "        s._pc = s._registers[0x%X] == s._registers[0x%X] ? 0x%03X : 0x%03X;\n", x, y, skip, next); break;
+    case 0x6000: Append(out, "        s._registers[0x%X] = 0x%02X;\n", x, nn); break;
+    case 0x7000: Append(out, "        s._registers[0x%X] += 0x%02X;\n", x, nn); break;
+    case 0x8000:
+    {
+        // VF is written before Vx is updated, exactly like the interpreter
+        switch (op & 0x000F)
+        {
+        case 0x0: Append(out, "        s._registers[0x%X] = s._registers[0x%X];\n", x, y); break;
+        case 0x1: Append(out, "        s._registers[0x%X] |= s._registers[0x%X];\n", x, y); break;
+        case 0x2: Append(out, "        s._registers[0x%X] &= s._registers[0x%X];\n", x, y); break;
+        case 0x3: Append(out, "        s._registers[0x%X] ^= s._registers[0x%X];\n", x, y); break;
+        case 0x4:
+            Append(out, "        { u16 sum = s._registers[0x%X] + s._registers[0x%X]; s._registers[0xF] = sum > 255 ? 1 : 0; s._registers[0x%X] = sum & 0xFF; }\n", x, y, x);
+            break;
+        case 0x5:
+            Append(out, "        s._registers[0xF] = s._registers[0x%X] > s._registers[0x%X] ? 1 : 0; s._registers[0x%X] -= s._registers[0x%X];\n", x, y, x, y);
+            break;
+        case 0x6:
+            Append(out, "        s._registers[0xF] = s._registers[0x%X] & 0x1; s._registers[0x%X] >>= 1;\n", x, x);
+            break;
+        case 0x7:
+            Append(out, "        s._registers[0xF] = s._registers[0x%X] > s._registers[0x%X] ? 1 : 0; s._registers[0x%X] = s._registers[0x%X] - s._registers[0x%X];\n", y, x, x, y, x);
+            break;
+        case 0xE:
+            Append(out, "        s._registers[0xF] = (s._registers[0x%X] & 0x80) >> 7; s._registers[0x%X] <<= 1;\n", x, x);
+            break;
+        }
+    } break;
+    case 0x9000: Append(out, "        s._pc = s._registers[0x%X] != s._registers[0x%X] ? 0x%03X : 0x%03X;\n", x, y, skip, next); break;
+    case 0xA000: Append(out, "        s._index = 0x%03X;\n", nnn); break;
+    case 0xB000: Append(out, "        s._pc = s._registers[0x0] + 0x%03X;\n", nnn); break;
+    case 0xE000:
+        if (nn == 0x9E)
+            Append(out, "        s._pc = s._key[s._registers[0x%X]] ? 0x%03X : 0x%03X;\n", x, skip, next);
+        else
+            Append(out, "        s._pc = !s._key[s._registers[0x%X]] ? 0x%03X : 0x%03X;\n", x, skip, next);
+        break;
+    case 0xF000:
+        if (nn == 0x1E)
+            Append(out, "        s._index += s._registers[0x%X];\n", x);
+        else
+        {
+            for (u8 i = 0; i <= x; i++)
+                Append(out, "        s._registers[0x%X] = s._memory[s._index + %u];\n", i, i);
+        }
+        break;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Types.h"
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Recovers the code reachable from the start address of a ROM and emits it as C++,
+// one function per basic block, for the Static dispatch mode of the CPU.
+class Recompiler
+{
+public:
+    bool AddRom(const std::filesystem::path& path);
+
+    std::string Generate() const;
+
+    size_t GetRomCount() const { return _roms.size(); }
+    size_t GetBlockCount() const;
+    size_t GetInstructionCount() const;
+
+private:
+    struct Rom
+    {
+        std::string name;
+        std::vector<u8> data;
+        std::map<u16, std::vector<u16>> blocks; // Start address -> opcodes
+    };
+
+    static bool IsSupported(u16 opcode);
+    static bool EndsBlock(u16 opcode);
+
+    void Analyze(Rom& rom) const;
+    void GenerateRom(std::string& out, const Rom& rom, size_t index) const;
+    void GenerateInstruction(std::string& out, u16 addr, u16 opcode) const;
+
+private:
+    static constexpr u16 START_ADDRESS = 0x200;
+    static constexpr u16 MAX_BLOCK_LENGTH = 32;
+
+    std::vector<Rom> _roms;
+};
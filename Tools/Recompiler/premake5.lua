@@ -0,0 +1,22 @@
+project "Chip8Recompiler"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "c++20"
+	staticruntime "on"
+	targetdir ("%{wks.location}/bin/%{cfg.buildcfg}")
+	objdir ("%{wks.location}/bin-int/%{cfg.buildcfg}/%{prj.name}")
+	
+	files { "**.h", "**.cpp" }
+	
+	includedirs
+	{
+		"%{wks.location}/Chip-8/Util"
+	}
+	
+	filter "configurations:Debug"
+		defines { "DEBUG" }
+		symbols "On"
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
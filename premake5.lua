@@ -10,4 +10,10 @@ workspace "Chip8"
 		include "Vendor/imgui/premake5.lua"
 	
 	group "Chip-8"
-		include "Chip-8/premake5.lua"
\ No newline at end of file
+		include "Chip-8/premake5.lua"
+	
+	group "Tools"
+		include "Tools/Recompiler/premake5.lua"
+		include "Tools/Bench/premake5.lua"
+		include "Tools/Headless/premake5.lua"
+		include "Tools/Batch/premake5.lua"
\ No newline at end of file